@@ -1,7 +1,11 @@
 #version 460 core
 
 uniform mat4 m_PerspectiveView;
+// Set per draw when drawing chunks one by one, read from drawBuffer at
+// gl_DrawID with multi draws
+uniform bool multiDraw;
 uniform vec3 chunkOrigin;
+uniform int faceDirection;
 
 out vec2 vsTex;
 out vec3 vsFragPos;
@@ -10,7 +14,15 @@ out float vsType;
 
 layout(std430, binding = 0) readonly buffer vertexPullBuffer
 {
-  ivec4 packed_data[]; // coords then direction. TODO add texture here in [dir]
+  // faces of every chunk, from the lowest bit: x (5), y (7), z (5),
+  // type (7), width - 1 (4), height - 1 (4), see pack_face in chunk_mesher.h
+  uint packed_data[];
+};
+
+layout(std430, binding = 1) readonly buffer drawBuffer
+{
+  // chunk origin (xyz) and face direction (w) of each multi draw
+  ivec4 draws[];
 };
 
 const vec3 normals[] = vec3[]
@@ -62,6 +74,14 @@ const vec2 uv_order[] = vec2[]
 );
 
 
+// size of a merged face along x, y and z, from its width (texture u axis)
+// and height (texture v axis)
+vec3 face_extent(int dir, int width, int height) {
+  if (dir < 2) return vec3(width, height, 1); // near, far
+  if (dir < 4) return vec3(1, height, width); // left, right
+  return vec3(width, 1, height);              // down, up
+}
+
 const float type_and_dir_to_texture[] = float[]
 (
   -1, -1, -1, -1, -1, -1, // 00: empty
@@ -82,19 +102,27 @@ void main() {
   // prepare indices & unpack data
   int face_index = gl_VertexID / 6;
   int vertex_index = gl_VertexID % 6;
-  ivec4 data = packed_data[face_index];
-  vec3 position = data.xyz + chunkOrigin;
-  int dir = data.w & 7;
-  int type = data.w >> 4;
+  uint data = packed_data[face_index];
+  vec3 origin = chunkOrigin;
+  int dir = faceDirection;
+  if (multiDraw) {
+    ivec4 draw = draws[gl_DrawID];
+    origin = vec3(draw.xyz);
+    dir = draw.w;
+  }
+  vec3 position = vec3(data & 31u, (data >> 5) & 127u, (data >> 12) & 31u) + origin;
+  int type = int((data >> 17) & 127u);
+  int width = int((data >> 24) & 15u) + 1;
+  int height = int(data >> 28) + 1;
   
   // prepare vertex data: uv and coords
   int index = indices_order[vertex_index];
-  position += vertex_positions[indices[index + 4*dir]];
+  position += vertex_positions[indices[index + 4*dir]] * face_extent(dir, width, height);
 
   // set out variables
   gl_Position = m_PerspectiveView * vec4(position, 1.0);
   vsFragPos = gl_Position.xyz;
-  vsTex = uv_order[index];
+  vsTex = uv_order[index] * vec2(width, height); // textures repeat over merged faces
   vsNormal = normals[dir];
   
   if (type < 60) { // solid blocks
@@ -0,0 +1,64 @@
+#include "free_list_allocator.h"
+#include <iterator>
+
+FreeListAllocator::FreeListAllocator(size_t capacity) : total(capacity), available(0)
+{
+  free(0, capacity);
+}
+
+size_t FreeListAllocator::allocate(size_t size)
+{
+  for (auto it = free_ranges.begin(); it != free_ranges.end(); ++it)
+  {
+    if (it->second < size)
+      continue;
+    size_t offset = it->first;
+    size_t remaining = it->second - size;
+    free_ranges.erase(it);
+    if (remaining > 0)
+      free_ranges[offset + size] = remaining;
+    available -= size;
+    return offset;
+  }
+  return INVALID;
+}
+
+void FreeListAllocator::free(size_t offset, size_t size)
+{
+  if (size == 0)
+    return;
+  available += size;
+  auto next = free_ranges.lower_bound(offset);
+  if (next != free_ranges.end() && offset + size == next->first)
+  {
+    size += next->second;
+    next = free_ranges.erase(next);
+  }
+  if (next != free_ranges.begin())
+  {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == offset)
+    {
+      previous->second += size;
+      return;
+    }
+  }
+  free_ranges.emplace_hint(next, offset, size);
+}
+
+void FreeListAllocator::grow(size_t new_capacity)
+{
+  size_t old_capacity = total;
+  total = new_capacity;
+  free(old_capacity, new_capacity - old_capacity);
+}
+
+bool FreeListAllocator::fragmented() const
+{
+  if (free_ranges.empty())
+    return false;
+  if (free_ranges.size() > 1)
+    return true;
+  auto only = free_ranges.begin();
+  return only->first + only->second != total;
+}
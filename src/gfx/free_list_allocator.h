@@ -0,0 +1,37 @@
+#ifndef FREE_LIST_ALLOCATOR_H
+#define FREE_LIST_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+// Hands out ranges of a space of capacity units. Free ranges are kept
+// sorted by offset: allocations take the first one large enough, freed
+// ranges are merged with the free ranges around them.
+class FreeListAllocator
+{
+public:
+  static const size_t INVALID = SIZE_MAX;
+
+  explicit FreeListAllocator(size_t capacity);
+
+  // Offset of a range of size units, INVALID if no free range is large
+  // enough
+  size_t allocate(size_t size);
+  void free(size_t offset, size_t size);
+  // Adds free space at the end
+  void grow(size_t new_capacity);
+
+  size_t capacity() const { return total; }
+  size_t free_size() const { return available; }
+  // Whether free space is split, or not all at the end
+  bool fragmented() const;
+
+private:
+  size_t total;
+  size_t available;
+  // Offset to size of each free range
+  std::map<size_t, size_t> free_ranges;
+};
+
+#endif
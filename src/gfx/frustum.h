@@ -0,0 +1,82 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+#include <cmath>
+
+struct Frustum
+{
+  // Boxes this close outside of a plane still intersect
+  static constexpr float EPSILON = 0.1f;
+  glm::vec4 planes[6];
+  Frustum() = default;
+  ~Frustum() {};
+  explicit Frustum(const glm::mat4 &pv)
+  {
+    // Left plane
+    planes[0] = glm::vec4(pv[0][3] + pv[0][0], pv[1][3] + pv[1][0],
+                          pv[2][3] + pv[2][0], pv[3][3] + pv[3][0]);
+    // Right plane
+    planes[1] = glm::vec4(pv[0][3] - pv[0][0], pv[1][3] - pv[1][0],
+                          pv[2][3] - pv[2][0], pv[3][3] - pv[3][0]);
+    // Bottom plane
+    planes[2] = glm::vec4(pv[0][3] + pv[0][1], pv[1][3] + pv[1][1],
+                          pv[2][3] + pv[2][1], pv[3][3] + pv[3][1]);
+    // Top plane
+    planes[3] = glm::vec4(pv[0][3] - pv[0][1], pv[1][3] - pv[1][1],
+                          pv[2][3] - pv[2][1], pv[3][3] - pv[3][1]);
+    // Near plane
+    planes[4] = glm::vec4(pv[0][3] - pv[0][2], pv[1][3] - pv[1][2],
+                          pv[2][3] - pv[2][2], pv[3][3] - pv[3][2]);
+    // Far plane
+    planes[5] = glm::vec4(pv[0][3] + pv[0][2], pv[1][3] + pv[1][2],
+                          pv[2][3] + pv[2][2], pv[3][3] + pv[3][2]);
+    for (int i = 0; i < 6; i++)
+    {
+      float length = glm::length(glm::vec3(planes[i]));
+      planes[i] /= length;
+    }
+  }
+
+  bool operator==(const Frustum &other) const
+  {
+    for (int i = 0; i < 6; i++)
+    {
+      if (planes[i] != other.planes[i])
+        return false;
+    }
+    return true;
+  }
+
+  // Test an axis-aligned box against all frustum planes
+  bool intersects(const glm::vec3 &min, const glm::vec3 &max) const
+  {
+    // Calculate center and half-extents of the AABB
+    glm::vec3 center = (min + max) * 0.5f;
+    glm::vec3 extents = (max - min) * 0.5f;
+
+    for (int i = 0; i < 6; i++)
+    {
+      const glm::vec4 &plane = planes[i];
+      glm::vec3 normal = glm::vec3(plane);
+
+      // TODO il y a un pb avec un des coins qui doit etre calculé par un min au lieu d'un max pour le z négatif, surely.
+
+      // Calculate radius in the direction of the plane normal
+      float radius = extents.x * std::abs(normal.x) +
+                     extents.y * std::abs(normal.y) +
+                     extents.z * std::abs(normal.z);
+
+      // Calculate distance from center to plane
+      float distance = glm::dot(normal, center) + plane.w;
+
+      // If distance is negative and greater than radius, the AABB is outside
+      if (distance < -radius - EPSILON)
+        return false;
+    }
+
+    return true;
+  }
+};
+
+#endif
@@ -14,7 +14,11 @@
 #include "vbo.h"
 #include "vao.h"
 #include "ssbo.h"
+#include "mesh_buffer.h"
+#include "staging_ring.h"
+#include "multi_draw_batch.h"
 #include "texture.h"
 #include "camera.h"
+#include "frustum.h"
 
 #endif
\ No newline at end of file
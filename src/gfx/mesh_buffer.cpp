@@ -0,0 +1,119 @@
+#include "mesh_buffer.h"
+#include <cassert>
+#include <iterator>
+
+MeshBuffer::MeshBuffer(size_t capacity) : allocator(capacity)
+{
+  id = create_storage(capacity);
+}
+
+MeshBuffer::~MeshBuffer()
+{
+  glDeleteBuffers(1, &id);
+}
+
+GLuint MeshBuffer::create_storage(size_t capacity)
+{
+  GLuint id;
+  glGenBuffers(1, &id);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+  glBufferStorage(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+  return id;
+}
+
+void MeshBuffer::grow(size_t min_capacity)
+{
+  size_t old_capacity = allocator.capacity();
+  size_t new_capacity = old_capacity;
+  while (new_capacity < min_capacity)
+    new_capacity *= 2;
+
+  GLuint new_id = create_storage(new_capacity);
+  glBindBuffer(GL_COPY_READ_BUFFER, id);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_capacity);
+  glDeleteBuffers(1, &id);
+  id = new_id;
+  allocator.grow(new_capacity);
+}
+
+MeshBuffer::Handle MeshBuffer::allocate(size_t size)
+{
+  if (size == 0)
+    return NONE;
+  size_t offset = allocator.allocate(size);
+  if (offset == FreeListAllocator::INVALID)
+  {
+    grow(allocator.capacity() + size);
+    offset = allocator.allocate(size);
+    assert(offset != FreeListAllocator::INVALID);
+  }
+
+  Handle handle;
+  if (!free_handles.empty())
+  {
+    handle = free_handles.back();
+    free_handles.pop_back();
+  }
+  else
+  {
+    handle = (Handle)ranges.size();
+    ranges.emplace_back();
+  }
+  ranges[handle] = {offset, size};
+  used_ranges[offset] = handle;
+  return handle;
+}
+
+void MeshBuffer::free(Handle handle)
+{
+  if (handle == NONE)
+    return;
+  Range &range = ranges[handle];
+  allocator.free(range.offset, range.size);
+  used_ranges.erase(range.offset);
+  free_handles.push_back(handle);
+}
+
+void MeshBuffer::write(Handle handle, size_t offset, const void *data, size_t size) const
+{
+  const Range &range = ranges[handle];
+  assert(offset + size <= range.size);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, range.offset + offset, size, data);
+}
+
+void MeshBuffer::bind(GLuint base) const
+{
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, base, id);
+}
+
+size_t MeshBuffer::defragment(size_t max_bytes)
+{
+  size_t moved = 0;
+  while (moved < max_bytes && allocator.fragmented() && !used_ranges.empty())
+  {
+    auto last = std::prev(used_ranges.end());
+    Handle handle = last->second;
+    Range &range = ranges[handle];
+    // First fit: the lowest free range large enough, which only helps if
+    // it is before the range. Free ranges never overlap used ones, the copy
+    // is between disjoint parts of the buffer.
+    size_t target = allocator.allocate(range.size);
+    if (target == FreeListAllocator::INVALID)
+      break;
+    if (target > range.offset)
+    {
+      allocator.free(target, range.size);
+      break;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, id);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range.offset, target, range.size);
+    allocator.free(range.offset, range.size);
+    used_ranges.erase(last);
+    used_ranges[target] = handle;
+    range.offset = target;
+    moved += range.size;
+  }
+  return moved;
+}
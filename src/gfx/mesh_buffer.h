@@ -0,0 +1,63 @@
+#ifndef MESH_BUFFER_H
+#define MESH_BUFFER_H
+
+#include <glad/glad.h>
+#include <map>
+#include <vector>
+
+#include "free_list_allocator.h"
+
+// One immutable GL buffer holding the meshes of every chunk, bound once as
+// a shader storage buffer. Meshes get a range of it through a handle that
+// stays valid when the range is moved by defragment. When no free range is
+// large enough the buffer is reallocated twice as large.
+class MeshBuffer
+{
+public:
+  typedef int Handle;
+  static const Handle NONE = -1;
+
+  explicit MeshBuffer(size_t capacity);
+  ~MeshBuffer();
+  MeshBuffer(const MeshBuffer &) = delete;
+  MeshBuffer &operator=(const MeshBuffer &) = delete;
+
+  // Range of size bytes, NONE for 0 bytes
+  Handle allocate(size_t size);
+  void free(Handle handle);
+  // Write size bytes at offset from the start of a range
+  void write(Handle handle, size_t offset, const void *data, size_t size) const;
+  // Offset in bytes of a range in the buffer, changes when defragmenting
+  size_t offset(Handle handle) const { return ranges[handle].offset; }
+  // GL buffer, changes when the buffer grows
+  GLuint buffer() const { return id; }
+  void bind(GLuint base) const;
+  // Move the last ranges of the buffer into free ranges before them, until
+  // max_bytes are moved or free space is all at the end. The copies run on
+  // the GPU, called once per frame to compact the buffer over time. Returns
+  // the bytes moved.
+  size_t defragment(size_t max_bytes);
+
+  size_t capacity() const { return allocator.capacity(); }
+  size_t used() const { return allocator.capacity() - allocator.free_size(); }
+
+private:
+  struct Range
+  {
+    size_t offset;
+    size_t size;
+  };
+
+  GLuint id;
+  FreeListAllocator allocator;
+  // Indexed by handle, handles of freed ranges are reused
+  std::vector<Range> ranges;
+  std::vector<Handle> free_handles;
+  // Handles of the allocated ranges by offset, to find the last one
+  std::map<size_t, Handle> used_ranges;
+
+  static GLuint create_storage(size_t capacity);
+  void grow(size_t min_capacity);
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include "multi_draw_batch.h"
+
+MultiDrawBatch::MultiDrawBatch()
+{
+  glGenBuffers(1, &command_buffer);
+  glGenBuffers(1, &data_buffer);
+}
+
+MultiDrawBatch::~MultiDrawBatch()
+{
+  glDeleteBuffers(1, &command_buffer);
+  glDeleteBuffers(1, &data_buffer);
+}
+
+void MultiDrawBatch::clear()
+{
+  commands.clear();
+  draw_data.clear();
+}
+
+void MultiDrawBatch::draw(GLuint data_binding)
+{
+  if (commands.empty())
+    return;
+  // Respecified every frame, the driver hands out fresh storage instead of
+  // waiting for the previous frame's draws
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawArraysCommand),
+               commands.data(), GL_STREAM_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, data_buffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, draw_data.size() * sizeof(glm::ivec4),
+               draw_data.data(), GL_STREAM_DRAW);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, data_binding, data_buffer);
+  glMultiDrawArraysIndirect(GL_TRIANGLES, nullptr, (GLsizei)commands.size(), 0);
+}
@@ -0,0 +1,46 @@
+#ifndef MULTI_DRAW_BATCH_H
+#define MULTI_DRAW_BATCH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Layout of glMultiDrawArraysIndirect commands
+struct DrawArraysCommand
+{
+  GLuint count;
+  GLuint instance_count;
+  GLuint first;
+  GLuint base_instance;
+};
+
+// Draws collected over a frame and submitted with a single
+// glMultiDrawArraysIndirect call. Each draw has an ivec4 of data the vertex
+// shader reads from a storage buffer at gl_DrawID.
+class MultiDrawBatch
+{
+public:
+  MultiDrawBatch();
+  ~MultiDrawBatch();
+  MultiDrawBatch(const MultiDrawBatch &) = delete;
+  MultiDrawBatch &operator=(const MultiDrawBatch &) = delete;
+
+  void clear();
+  void add(GLuint first, GLuint count, const glm::ivec4 &data)
+  {
+    commands.push_back({count, 1, first, 0});
+    draw_data.push_back(data);
+  }
+  // Upload the commands and their data, bound at data_binding, and draw
+  // them as triangles
+  void draw(GLuint data_binding);
+  size_t size() const { return commands.size(); }
+
+private:
+  std::vector<DrawArraysCommand> commands;
+  std::vector<glm::ivec4> draw_data;
+  GLuint command_buffer;
+  GLuint data_buffer;
+};
+
+#endif
@@ -21,7 +21,7 @@ void SSBO::bind(GLuint base) const
 }
 
 // maybe do not do this to update the buffer ? no need to
-void SSBO::set_buffer(void *data, size_t count, GLuint base) const
+void SSBO::set_buffer(const void *data, size_t count, GLuint base) const
 {
   shader->use();
   this->bind(0);
@@ -29,7 +29,7 @@ void SSBO::set_buffer(void *data, size_t count, GLuint base) const
   glBufferData(GL_SHADER_STORAGE_BUFFER, count, data, dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
 }
 
-void SSBO::update_buffer(void *data, size_t count) const
+void SSBO::update_buffer(const void *data, size_t count) const
 {
   shader->use();
   this->bind(0);
@@ -16,8 +16,8 @@ public:
   SSBO(Shader *shader, bool dynamic);
   ~SSBO();
   void bind(GLuint base) const;
-  void set_buffer(void *data, size_t count, GLuint base) const;
-  void update_buffer(void *data, size_t count) const;
+  void set_buffer(const void *data, size_t count, GLuint base) const;
+  void update_buffer(const void *data, size_t count) const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "staging_ring.h"
+#include <cassert>
+
+StagingRing::StagingRing(size_t capacity) : capacity(capacity)
+{
+  const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glGenBuffers(1, &id);
+  glBindBuffer(GL_COPY_READ_BUFFER, id);
+  glBufferStorage(GL_COPY_READ_BUFFER, capacity, nullptr, flags);
+  mapped = (uint8_t *)glMapBufferRange(GL_COPY_READ_BUFFER, 0, capacity, flags);
+}
+
+StagingRing::~StagingRing()
+{
+  for (const Fence &fence : fences)
+    glDeleteSync(fence.sync);
+  if (mapped)
+  {
+    glBindBuffer(GL_COPY_READ_BUFFER, id);
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+  }
+  glDeleteBuffers(1, &id);
+}
+
+bool StagingRing::reserve(size_t size, StagingRange &range)
+{
+  if (!mapped || size == 0 || size > capacity)
+    return false;
+  std::lock_guard lock(mutex);
+  size_t offset = 0;
+  if (!blocks.empty())
+  {
+    size_t tail = blocks.front().offset;
+    size_t head = blocks.back().offset + blocks.back().size;
+    // Before wrapping around, free space is after the head and before the
+    // tail. After, it is between the head and the tail.
+    if (head > tail && head + size <= capacity)
+      offset = head;
+    else if (head > tail && size <= tail)
+      offset = 0;
+    else if (head <= tail && head + size <= tail)
+      offset = head;
+    else
+      return false;
+  }
+  blocks.push_back({offset, size, RESERVED, 0});
+  range.id = first_id + blocks.size() - 1;
+  range.offset = offset;
+  range.size = size;
+  range.data = mapped + offset;
+  return true;
+}
+
+void StagingRing::copy(const StagingRange &range, GLuint target, size_t target_offset)
+{
+  glBindBuffer(GL_COPY_READ_BUFFER, id);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range.offset, target_offset, range.size);
+  std::lock_guard lock(mutex);
+  block(range.id).state = COPIED;
+  copied_since_fence = true;
+}
+
+void StagingRing::end_frame()
+{
+  std::lock_guard lock(mutex);
+  if (!copied_since_fence)
+    return;
+  uint64_t serial = next_fence++;
+  fences.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), serial});
+  for (Block &block : blocks)
+  {
+    if (block.state == COPIED)
+    {
+      block.state = FENCED;
+      block.fence = serial;
+    }
+  }
+  copied_since_fence = false;
+}
+
+void StagingRing::reclaim()
+{
+  std::lock_guard lock(mutex);
+  while (!fences.empty())
+  {
+    Fence &fence = fences.front();
+    GLenum status = glClientWaitSync(fence.sync, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      break;
+    for (Block &block : blocks)
+    {
+      if (block.state == FENCED && block.fence <= fence.serial)
+        block.state = DONE;
+    }
+    glDeleteSync(fence.sync);
+    fences.pop_front();
+  }
+  pop_done_blocks();
+}
+
+void StagingRing::pop_done_blocks()
+{
+  while (!blocks.empty() && blocks.front().state == DONE)
+  {
+    blocks.pop_front();
+    first_id++;
+  }
+}
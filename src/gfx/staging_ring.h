@@ -0,0 +1,83 @@
+#ifndef STAGING_RING_H
+#define STAGING_RING_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+// Part of the staging ring reserved for one upload
+struct StagingRange
+{
+  uint64_t id = 0;
+  size_t offset = 0;
+  size_t size = 0;
+  // Null when nothing is reserved
+  uint8_t *data = nullptr;
+};
+
+// Persistently mapped buffer that data is written into from any thread,
+// then copied into GPU buffers by the thread holding the GL context. Ranges
+// are reserved one after the other around the ring, and reused once the GPU
+// is done copying them: copies are fenced once per frame.
+class StagingRing
+{
+public:
+  explicit StagingRing(size_t capacity);
+  ~StagingRing();
+  StagingRing(const StagingRing &) = delete;
+  StagingRing &operator=(const StagingRing &) = delete;
+
+  // From any thread. Returns false when the ring has no room left, or could
+  // not be mapped.
+  bool reserve(size_t size, StagingRange &range);
+  // Copy a range into target at target_offset, then reuse it once the copy
+  // is done
+  void copy(const StagingRange &range, GLuint target, size_t target_offset);
+  // Fence the copies issued since the last call, once per frame after them
+  void end_frame();
+  // Reuse the ranges whose copies are done, once per frame
+  void reclaim();
+
+private:
+  enum BlockState
+  {
+    RESERVED,
+    // Copy issued this frame, not fenced yet
+    COPIED,
+    // Waiting for the fence of its frame
+    FENCED,
+    DONE,
+  };
+
+  struct Block
+  {
+    size_t offset;
+    size_t size;
+    BlockState state;
+    uint64_t fence;
+  };
+
+  struct Fence
+  {
+    GLsync sync;
+    uint64_t serial;
+  };
+
+  GLuint id;
+  size_t capacity;
+  uint8_t *mapped = nullptr;
+  std::mutex mutex;
+  // Reserved blocks in ring order, block id first_id first
+  std::deque<Block> blocks;
+  uint64_t first_id = 1;
+  std::deque<Fence> fences;
+  uint64_t next_fence = 1;
+  bool copied_since_fence = false;
+
+  Block &block(uint64_t id) { return blocks[id - first_id]; }
+  void pop_done_blocks();
+};
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef CANCELLATION_TOKEN_H
+#define CANCELLATION_TOKEN_H
+
+#include <atomic>
+#include <memory>
+
+// Shared flag used to ask a job to stop early. Copies share the same flag:
+// the owner keeps one to cancel, the job keeps one and checks it between
+// steps.
+class CancellationToken
+{
+public:
+  CancellationToken() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+  void cancel() const { flag->store(true, std::memory_order_relaxed); }
+  bool cancelled() const { return flag->load(std::memory_order_relaxed); }
+
+private:
+  std::shared_ptr<std::atomic<bool>> flag;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "job_system.h"
+
+// Index of the worker running on this thread, -1 outside of the pool
+static thread_local int current_worker = -1;
+
+JobSystem::JobSystem(int workers)
+{
+  if (workers <= 0)
+    workers = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+
+  for (int i = 0; i < workers; i++)
+    queues.push_back(std::make_unique<WorkerQueue>());
+  for (int i = 0; i < workers; i++)
+    threads.emplace_back(&JobSystem::worker_loop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex);
+    running = false;
+  }
+  wake.notify_all();
+  for (auto &thread : threads)
+    thread.join();
+}
+
+void JobSystem::submit(std::function<void()> job)
+{
+  bool external = current_worker < 0;
+  int index = external ? (int)(next_queue++ % queues.size()) : current_worker;
+  {
+    WorkerQueue &queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    (external ? queue.external_jobs : queue.jobs).push_back(std::move(job));
+  }
+  {
+    // Taken so that a worker can't miss the notification between checking
+    // queued and going to sleep
+    std::lock_guard<std::mutex> lock(sleep_mutex);
+    queued++;
+  }
+  wake.notify_one();
+}
+
+bool JobSystem::pop(int index, std::function<void()> &job)
+{
+  {
+    WorkerQueue &own = *queues[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.jobs.empty())
+    {
+      job = std::move(own.jobs.back());
+      own.jobs.pop_back();
+      return true;
+    }
+    if (!own.external_jobs.empty())
+    {
+      job = std::move(own.external_jobs.front());
+      own.external_jobs.pop_front();
+      return true;
+    }
+  }
+
+  for (size_t i = 1; i < queues.size(); i++)
+  {
+    WorkerQueue &victim = *queues[(index + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    std::deque<std::function<void()>> &jobs =
+        victim.jobs.empty() ? victim.external_jobs : victim.jobs;
+    if (!jobs.empty())
+    {
+      job = std::move(jobs.front());
+      jobs.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void JobSystem::worker_loop(int index)
+{
+  current_worker = index;
+  std::function<void()> job;
+  while (true)
+  {
+    if (pop(index, job))
+    {
+      queued--;
+      job();
+      job = nullptr;
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleep_mutex);
+    wake.wait(lock, [this]()
+              { return !running || queued > 0; });
+    // Jobs still queued at shutdown run before the workers return
+    if (!running && queued == 0)
+      return;
+  }
+}
@@ -0,0 +1,64 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent pool of worker threads. Each worker owns two deques of jobs:
+// the jobs it submitted itself, popped from the back, and the jobs
+// submitted from outside the pool, spread over the workers round-robin and
+// popped from the front, so that they run in the order they were submitted.
+// A worker runs its own jobs first, then the outside ones, and when it runs
+// out it steals from the front of the other workers' deques.
+class JobSystem
+{
+public:
+  // 0 workers: one per hardware thread, minus the main thread
+  explicit JobSystem(int workers = 0);
+  // Runs the jobs still queued, then joins the workers
+  ~JobSystem();
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  int worker_count() const { return (int)threads.size(); }
+  void submit(std::function<void()> job);
+
+  template <typename F>
+  auto submit_with_future(F &&f) -> std::future<decltype(f())>
+  {
+    using R = decltype(f());
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+    std::future<R> future = task->get_future();
+    submit([task]()
+           { (*task)(); });
+    return future;
+  }
+
+private:
+  struct WorkerQueue
+  {
+    std::mutex mutex;
+    std::deque<std::function<void()>> jobs;
+    std::deque<std::function<void()>> external_jobs;
+  };
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues;
+  std::vector<std::thread> threads;
+  std::atomic<bool> running{true};
+  std::atomic<int> queued{0};
+  std::atomic<unsigned> next_queue{0};
+  std::mutex sleep_mutex;
+  std::condition_variable wake;
+
+  void worker_loop(int index);
+  bool pop(int index, std::function<void()> &job);
+};
+
+#endif
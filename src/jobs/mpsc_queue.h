@@ -0,0 +1,66 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <utility>
+
+// Unbounded lock-free multi-producer single-consumer queue (Vyukov's
+// node-based queue). Any thread can push, a single thread pops. A push that
+// is still in progress can make the queue look empty for a moment, the
+// consumer just sees the item on its next pop.
+template <typename T>
+class MPSCQueue
+{
+public:
+  MPSCQueue()
+  {
+    Node *stub = new Node();
+    head.store(stub, std::memory_order_relaxed);
+    tail = stub;
+  }
+
+  ~MPSCQueue()
+  {
+    T value;
+    while (pop(value))
+      ;
+    delete tail;
+  }
+
+  MPSCQueue(const MPSCQueue &) = delete;
+  MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+  void push(T value)
+  {
+    Node *node = new Node(std::move(value));
+    Node *prev = head.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  // Consumer thread only
+  bool pop(T &value)
+  {
+    Node *next = tail->next.load(std::memory_order_acquire);
+    if (next == nullptr)
+      return false;
+    value = std::move(next->value);
+    delete tail;
+    tail = next;
+    return true;
+  }
+
+private:
+  struct Node
+  {
+    std::atomic<Node *> next{nullptr};
+    T value;
+
+    Node() = default;
+    explicit Node(T value) : value(std::move(value)) {}
+  };
+
+  std::atomic<Node *> head;
+  Node *tail;
+};
+
+#endif
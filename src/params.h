@@ -1,9 +1,25 @@
 #ifndef PARAMS_H
 #define PARAMS_H
 
-#define MAX_ACTIVE_THREADS 16
+#define JOBS_PER_WORKER 2
+// Bytes of meshes uploaded per frame, and size of the persistently mapped
+// ring workers write meshes into before upload
+#define UPLOAD_BUDGET (4 * 1024 * 1024)
+#define STAGING_RING_SIZE ((size_t)32 * 1024 * 1024)
+// Initial size of the buffer holding every chunk mesh, it doubles when
+// full, and bytes of meshes moved per frame to compact it
+#define MESH_BUFFER_SIZE ((size_t)64 * 1024 * 1024)
+#define DEFRAG_BUDGET (1024 * 1024)
 #define CHUNKS_SIZE 32
 #define WORLD_HEIGHT 120
+#define SECTION_HEIGHT 24
+#define SECTIONS_COUNT (WORLD_HEIGHT / SECTION_HEIGHT)
 #define RENDER_DISTANCE 20
+// Chunks are unloaded past RENDER_DISTANCE + UNLOAD_MARGIN, and the least
+// recently visible ones when the loaded chunks use more than
+// CHUNKS_MEMORY_CAP bytes
+#define UNLOAD_MARGIN 4
+#define UNLOAD_INTERVAL 60
+#define CHUNKS_MEMORY_CAP ((size_t)512 * 1024 * 1024)
 
 #endif
\ No newline at end of file
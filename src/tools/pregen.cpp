@@ -0,0 +1,238 @@
+// Headless world pre-generation: generates and meshes a square region of
+// chunks on every core, without a window or OpenGL, and reports how fast
+// each stage runs. Used to benchmark the generator and the mesher, and to
+// fill a world on disk ahead of time.
+//
+//   pregen <size> [--seed n] [--threads n] [--mode naive|greedy|binary] [--out dir]
+
+#include "../params.h"
+#include "../world/world_generator.h"
+#include "../world/chunk_data.h"
+#include "../jobs/job_system.h"
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace glm;
+using Clock = std::chrono::steady_clock;
+
+// Milliseconds taken by one chunk in each stage
+struct StageTimes
+{
+  std::vector<double> generate;
+  std::vector<double> mesh;
+  std::vector<double> save;
+};
+
+static double elapsed_ms(Clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+  if (values.empty())
+    return 0;
+  std::sort(values.begin(), values.end());
+  size_t i = (size_t)(p * (values.size() - 1) + 0.5);
+  return values[i];
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s <size> [--seed n] [--threads n] [--mode naive|greedy|binary] [--out dir]\n"
+          "  generates and meshes size x size chunks around the origin\n",
+          name);
+  exit(EXIT_FAILURE);
+}
+
+// Writes the blocks of a chunk, unpacked, one byte per block in section
+// order, to <dir>/chunk.<x>.<z>.bin
+static bool save_chunk(const std::string &dir, const ChunkData &chunk)
+{
+  ivec3 coords = chunk.origin / CHUNKS_SIZE;
+  std::string path = dir + "/chunk." + std::to_string(coords.x) + "." +
+                     std::to_string(coords.z) + ".bin";
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file)
+    return false;
+  static thread_local std::vector<uint8_t> blocks(ChunkSection::volume);
+  bool ok = true;
+  for (int s = 0; s < SECTIONS_COUNT && ok; s++)
+  {
+    chunk.sections[s].blocks.unpack(0, ChunkSection::volume, blocks.data());
+    ok = fwrite(blocks.data(), 1, blocks.size(), file) == blocks.size();
+  }
+  return fclose(file) == 0 && ok;
+}
+
+static void print_stage(const char *name, const std::vector<double> &times, double wall_ms)
+{
+  printf("  %-8s p50 %7.3f ms  p99 %7.3f ms  %8.1f chunks/s\n", name,
+         percentile(times, 0.5), percentile(times, 0.99), times.size() * 1000.0 / wall_ms);
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+    usage(argv[0]);
+  int size = atoi(argv[1]);
+  int seed = 1337;
+  int threads = (int)std::thread::hardware_concurrency();
+  MeshingMode mode = MESHING_GREEDY;
+  std::string out_dir;
+  for (int i = 2; i < argc; i++)
+  {
+    if (i + 1 >= argc)
+      usage(argv[0]);
+    if (!strcmp(argv[i], "--seed"))
+      seed = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--threads"))
+      threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--out"))
+      out_dir = argv[++i];
+    else if (!strcmp(argv[i], "--mode"))
+    {
+      std::string name = argv[++i];
+      if (name == "naive")
+        mode = MESHING_NAIVE;
+      else if (name == "greedy")
+        mode = MESHING_GREEDY;
+      else if (name == "binary")
+        mode = MESHING_BINARY;
+      else
+        usage(argv[0]);
+    }
+    else
+      usage(argv[0]);
+  }
+  if (size <= 0 || threads <= 0)
+    usage(argv[0]);
+
+  WorldGenerator generator(seed);
+  // The main thread only waits, every core runs jobs
+  JobSystem jobs(threads);
+
+  int count = size * size;
+  int first = -size / 2;
+  std::vector<ivec3> coords(count);
+  std::vector<std::unique_ptr<ChunkData>> chunks(count);
+  for (int i = 0; i < count; i++)
+  {
+    coords[i] = ivec3(first + i % size, 0, first + i / size);
+    chunks[i] = std::make_unique<ChunkData>(coords[i]);
+  }
+  auto chunk_at = [&](int x, int z) -> const ChunkData *
+  {
+    x -= first;
+    z -= first;
+    if (x < 0 || z < 0 || x >= size || z >= size)
+      return nullptr;
+    return chunks[z * size + x].get();
+  };
+
+  printf("pregen: %d x %d chunks, seed %d, %d threads, noise simd width %d\n",
+         size, size, seed, jobs.worker_count(), BatchNoise::simd_width());
+
+  // Each stage waits for the previous one: meshing reads the borders of the
+  // neighbouring chunks, which must all be generated.
+  StageTimes times;
+  times.generate.resize(count);
+  times.mesh.resize(count);
+  std::vector<std::future<void>> done;
+
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < count; i++)
+    done.push_back(jobs.submit_with_future([&, i]()
+                                           {
+      Clock::time_point t = Clock::now();
+      ChunkData &chunk = *chunks[i];
+      generator.fill_with_terrain(chunk.sections, chunk.origin);
+      times.generate[i] = elapsed_ms(t); }));
+  for (auto &f : done)
+    f.get();
+  double generate_wall = elapsed_ms(start);
+
+  done.clear();
+  Clock::time_point mesh_start = Clock::now();
+  for (int i = 0; i < count; i++)
+    done.push_back(jobs.submit_with_future([&, i]()
+                                           {
+      Clock::time_point t = Clock::now();
+      ChunkData &chunk = *chunks[i];
+      // Chunks on the edge of the region see air past it
+      static thread_local ChunkBorders borders;
+      const ivec3 offsets[4] = {ivec3(0, 0, 1), ivec3(0, 0, -1), ivec3(-1, 0, 0), ivec3(1, 0, 0)};
+      const Direction facing[4] = {FORWARD, BACKWARD, RIGHT, LEFT};
+      for (int d = 0; d < 4; d++)
+      {
+        ivec3 n = coords[i] + offsets[d];
+        const ChunkData *neighbour = chunk_at(n.x, n.z);
+        if (neighbour)
+          neighbour->copy_border(facing[d], borders.blocks[d]);
+        else
+          memset(borders.blocks[d], AIR, sizeof(borders.blocks[d]));
+      }
+      chunk.prepare_mesh_data(borders, mode);
+      times.mesh[i] = elapsed_ms(t); }));
+  for (auto &f : done)
+    f.get();
+  double mesh_wall = elapsed_ms(mesh_start);
+
+  double save_wall = 0;
+  bool save_failed = false;
+  if (!out_dir.empty())
+  {
+    times.save.resize(count);
+    std::vector<std::future<bool>> saved;
+    Clock::time_point save_start = Clock::now();
+    for (int i = 0; i < count; i++)
+      saved.push_back(jobs.submit_with_future([&, i]()
+                                              {
+        Clock::time_point t = Clock::now();
+        bool ok = save_chunk(out_dir, *chunks[i]);
+        times.save[i] = elapsed_ms(t);
+        return ok; }));
+    for (auto &f : saved)
+      save_failed |= !f.get();
+    save_wall = elapsed_ms(save_start);
+  }
+  double total_wall = elapsed_ms(start);
+
+  size_t faces = 0;
+  size_t blocks_memory = 0;
+  for (const auto &chunk : chunks)
+  {
+    faces += chunk->mesh_size() / sizeof(uint32_t);
+    for (int s = 0; s < SECTIONS_COUNT; s++)
+      blocks_memory += chunk->sections[s].blocks.memory_usage();
+  }
+
+  struct rusage resources;
+  getrusage(RUSAGE_SELF, &resources);
+
+  printf("%d chunks in %.1f ms, %.1f chunks/s\n", count, total_wall, count * 1000.0 / total_wall);
+  print_stage("generate", times.generate, generate_wall);
+  print_stage("mesh", times.mesh, mesh_wall);
+  if (!out_dir.empty())
+    print_stage("save", times.save, save_wall);
+  printf("%zu faces, %.1f faces/chunk\n", faces, (double)faces / count);
+  printf("blocks %.1f MB, peak rss %.1f MB\n", blocks_memory / (1024.0 * 1024.0),
+         resources.ru_maxrss / 1024.0);
+  if (save_failed)
+  {
+    fprintf(stderr, "could not write every chunk to %s\n", out_dir.c_str());
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,248 @@
+#include "batch_noise.h"
+#include <cstring>
+
+BatchNoise::BatchNoise(const NoiseSettings &settings) : settings(settings)
+{
+  noise.SetSeed(settings.seed);
+  noise.SetFrequency(settings.frequency);
+  noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+  if (settings.octaves > 1)
+  {
+    noise.SetFractalType(FastNoiseLite::FractalType_FBm);
+    noise.SetFractalOctaves(settings.octaves);
+    noise.SetFractalLacunarity(settings.lacunarity);
+    noise.SetFractalGain(settings.gain);
+    noise.SetFractalWeightedStrength(settings.weighted_strength);
+  }
+
+  // Same as FastNoiseLite::CalculateFractalBounding
+  float gain = settings.gain < 0 ? -settings.gain : settings.gain;
+  float amp = gain;
+  float amp_fractal = 1.0f;
+  for (int i = 1; i < settings.octaves; i++)
+  {
+    amp_fractal += amp;
+    amp *= gain;
+  }
+  fractal_bounding = 1 / amp_fractal;
+}
+
+float BatchNoise::get(float x, float z) const
+{
+  return noise.GetNoise(x, z);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+// Vector code written with GCC vector extensions, compiled for AVX2 and
+// SSE4.1 by inlining it into functions targeting each. Vectors never cross
+// a function call, the ABI warning does not apply.
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+typedef float f32x4 __attribute__((vector_size(16)));
+typedef int i32x4 __attribute__((vector_size(16)));
+typedef unsigned u32x4 __attribute__((vector_size(16)));
+typedef float f32x8 __attribute__((vector_size(32)));
+typedef int i32x8 __attribute__((vector_size(32)));
+typedef unsigned u32x8 __attribute__((vector_size(32)));
+
+// FastNoiseLite's Lookup<float>::Gradients2D: 24 directions repeated five
+// times, then 8 more
+static const float gradients_2d[24 * 2 + 8 * 2] = {
+    0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+    0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+    0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+    -0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+    -0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+    -0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+    0.38268343236509f, 0.923879532511287f, 0.923879532511287f, 0.38268343236509f, 0.923879532511287f, -0.38268343236509f, 0.38268343236509f, -0.923879532511287f,
+    -0.38268343236509f, -0.923879532511287f, -0.923879532511287f, -0.38268343236509f, -0.923879532511287f, 0.38268343236509f, -0.38268343236509f, 0.923879532511287f,
+};
+
+// Indexed like Gradients2D, by an even hash below 256
+static float gradient(int hash)
+{
+  int g = hash >> 1;
+  return g < 120 ? gradients_2d[(g % 24) * 2 + (hash & 1)] : gradients_2d[(g - 96) * 2 + (hash & 1)];
+}
+
+struct GradientTable
+{
+  float values[256];
+  GradientTable()
+  {
+    for (int i = 0; i < 256; i++)
+      values[i] = gradient(i);
+  }
+};
+static const GradientTable gradient_table;
+
+static const int PRIME_X = 501125321;
+static const int PRIME_Y = 1136930381;
+
+template <typename F, typename I>
+static inline __attribute__((always_inline)) F select(const I &mask, const F &a, const F &b)
+{
+  return (F)(((I)a & mask) | ((I)b & ~mask));
+}
+
+template <typename F, typename I>
+static inline __attribute__((always_inline)) I fast_floor(const F &f)
+{
+  // (int)f - 1 for negative f, comparisons give -1 for true
+  return __builtin_convertvector(f, I) + (I)(f < 0);
+}
+
+template <typename F, typename I, typename U, int N>
+static inline __attribute__((always_inline)) F grad_coord(int seed, const I &x_primed, const I &y_primed, const F &xd, const F &yd)
+{
+  I hash = (I)(((U)(seed ^ x_primed ^ y_primed)) * 0x27d4eb2du);
+  hash ^= hash >> 15;
+  hash &= 127 << 1;
+
+  F xg, yg;
+  for (int k = 0; k < N; k++)
+  {
+    xg[k] = gradient_table.values[hash[k]];
+    yg[k] = gradient_table.values[hash[k] | 1];
+  }
+  return xd * xg + yd * yg;
+}
+
+// FastNoiseLite::SingleSimplex
+template <typename F, typename I, typename U, int N>
+static inline __attribute__((always_inline)) F simplex(int seed, const F &x, const F &y)
+{
+  const float SQRT3 = 1.7320508075688772935274463415059f;
+  const float G2 = (3 - SQRT3) / 6;
+
+  I i = fast_floor<F, I>(x);
+  I j = fast_floor<F, I>(y);
+  F xi = x - __builtin_convertvector(i, F);
+  F yi = y - __builtin_convertvector(j, F);
+
+  F t = (xi + yi) * G2;
+  F x0 = xi - t;
+  F y0 = yi - t;
+
+  i = (I)((U)i * (unsigned)PRIME_X);
+  j = (I)((U)j * (unsigned)PRIME_Y);
+  F zero = {};
+
+  F a = 0.5f - x0 * x0 - y0 * y0;
+  F n0 = select(a > 0, (a * a) * (a * a) * grad_coord<F, I, U, N>(seed, i, j, x0, y0), zero);
+
+  F c = (float)(2 * (1 - 2 * G2) * (1 / G2 - 2)) * t + ((float)(-2 * (1 - 2 * G2) * (1 - 2 * G2)) + a);
+  F x2 = x0 + (2 * (float)G2 - 1);
+  F y2 = y0 + (2 * (float)G2 - 1);
+  I i2 = (I)((U)i + (unsigned)PRIME_X);
+  I j2 = (I)((U)j + (unsigned)PRIME_Y);
+  F n2 = select(c > 0, (c * c) * (c * c) * grad_coord<F, I, U, N>(seed, i2, j2, x2, y2), zero);
+
+  // Second corner: (i, j + 1) above the diagonal, (i + 1, j) below
+  I above = y0 > x0;
+  F x1 = x0 + select(above, zero + (float)G2, zero + ((float)G2 - 1));
+  F y1 = y0 + select(above, zero + ((float)G2 - 1), zero + (float)G2);
+  I i1 = (I)((U)i + ((U)~above & (unsigned)PRIME_X));
+  I j1 = (I)((U)j + ((U)above & (unsigned)PRIME_Y));
+  F b = 0.5f - x1 * x1 - y1 * y1;
+  F n1 = select(b > 0, (b * b) * (b * b) * grad_coord<F, I, U, N>(seed, i1, j1, x1, y1), zero);
+
+  return (n0 + n1 + n2) * 99.83685446303647f;
+}
+
+// FastNoiseLite::GetNoise for OpenSimplex2, without or with FBm
+template <typename F, typename I, typename U, int N>
+static inline __attribute__((always_inline)) F noise_at(const NoiseSettings &settings, float fractal_bounding, const F &px, const F &py)
+{
+  F x = px * settings.frequency;
+  F y = py * settings.frequency;
+  const float SQRT3 = (float)1.7320508075688772935274463415059;
+  const float F2 = 0.5f * (SQRT3 - 1);
+  F t = (x + y) * F2;
+  x += t;
+  y += t;
+
+  if (settings.octaves <= 1)
+    return simplex<F, I, U, N>(settings.seed, x, y);
+
+  int seed = settings.seed;
+  F zero = {};
+  F sum = zero;
+  F amp = zero + fractal_bounding;
+  for (int o = 0; o < settings.octaves; o++)
+  {
+    F noise = simplex<F, I, U, N>(seed++, x, y);
+    sum += noise * amp;
+    F n = noise + 1;
+    F weighted = select(n < 2, n, zero + 2) * 0.5f;
+    amp *= 1.0f + settings.weighted_strength * (weighted - 1.0f);
+
+    x *= settings.lacunarity;
+    y *= settings.lacunarity;
+    amp *= settings.gain;
+  }
+  return sum;
+}
+
+template <typename F, typename I, typename U, int N>
+static inline __attribute__((always_inline)) int noise_batch(const NoiseSettings &settings, float fractal_bounding,
+                                                             const float *x, const float *z, int n, float *out)
+{
+  int i = 0;
+  for (; i + N <= n; i += N)
+  {
+    F xv, zv;
+    memcpy(&xv, x + i, sizeof(F));
+    memcpy(&zv, z + i, sizeof(F));
+    F result = noise_at<F, I, U, N>(settings, fractal_bounding, xv, zv);
+    memcpy(out + i, &result, sizeof(F));
+  }
+  return i;
+}
+
+__attribute__((target("avx2"), flatten)) static int noise_batch_avx2(
+    const NoiseSettings &settings, float fractal_bounding, const float *x, const float *z, int n, float *out)
+{
+  return noise_batch<f32x8, i32x8, u32x8, 8>(settings, fractal_bounding, x, z, n, out);
+}
+
+__attribute__((target("sse4.1"), flatten)) static int noise_batch_sse(
+    const NoiseSettings &settings, float fractal_bounding, const float *x, const float *z, int n, float *out)
+{
+  return noise_batch<f32x4, i32x4, u32x4, 4>(settings, fractal_bounding, x, z, n, out);
+}
+
+int BatchNoise::simd_width()
+{
+  static const int width = __builtin_cpu_supports("avx2")     ? 8
+                           : __builtin_cpu_supports("sse4.1") ? 4
+                                                              : 1;
+  return width;
+}
+
+void BatchNoise::get_batch(const float *x, const float *z, int n, float *out) const
+{
+  int done = 0;
+  if (simd_width() == 8)
+    done = noise_batch_avx2(settings, fractal_bounding, x, z, n, out);
+  else if (simd_width() == 4)
+    done = noise_batch_sse(settings, fractal_bounding, x, z, n, out);
+  for (int i = done; i < n; i++)
+    out[i] = get(x[i], z[i]);
+}
+
+#else
+
+int BatchNoise::simd_width()
+{
+  return 1;
+}
+
+void BatchNoise::get_batch(const float *x, const float *z, int n, float *out) const
+{
+  for (int i = 0; i < n; i++)
+    out[i] = get(x[i], z[i]);
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef BATCH_NOISE_H
+#define BATCH_NOISE_H
+
+#include "fastnoiselite.h"
+
+// Settings of an OpenSimplex2 noise, FBm when it has several octaves. The
+// defaults are FastNoiseLite's.
+struct NoiseSettings
+{
+  int seed = 1337;
+  float frequency = 0.01f;
+  int octaves = 1;
+  float lacunarity = 2.0f;
+  float gain = 0.5f;
+  float weighted_strength = 0.0f;
+};
+
+// 2D OpenSimplex2 noise, as computed by FastNoiseLite, that can also be
+// evaluated on many points at once. Batches run 8 points at a time with
+// AVX2 or 4 with SSE4.1, picked at runtime, and fall back to FastNoiseLite
+// one point at a time. The vector code performs the same float operations
+// in the same order as FastNoiseLite, so batches are bit for bit identical
+// to single points. That holds as long as the compiler does not fuse
+// multiply-adds, so every FastNoiseLite call is made from batch_noise.cpp,
+// which is built with -ffp-contract=off: with FMA enabled, e.g.
+// -march=native, both sides would fuse differently.
+class BatchNoise
+{
+public:
+  BatchNoise(const NoiseSettings &settings = NoiseSettings());
+
+  float get(float x, float z) const;
+  // out[i] = get(x[i], z[i])
+  void get_batch(const float *x, const float *z, int n, float *out) const;
+  // Points evaluated at once by get_batch on this CPU
+  static int simd_width();
+
+private:
+  NoiseSettings settings;
+  // Scales the sum of the octaves into [-1, 1]
+  float fractal_bounding;
+  FastNoiseLite noise;
+};
+
+#endif
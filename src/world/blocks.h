@@ -21,4 +21,10 @@ struct Block
     BlockType type = AIR;
 };
 
+// Whether a block hides the faces of the blocks next to it
+inline bool is_occluding(BlockType type)
+{
+    return type != AIR && type != LEAVES;
+}
+
 #endif
\ No newline at end of file
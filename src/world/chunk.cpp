@@ -1,5 +1,5 @@
 #include "chunk.h"
-#include "world_generator.h"
+#include <cstring>
 
 using namespace glm;
 
@@ -25,133 +25,137 @@ bool Chunk::player_sees_face(const Camera &camera, const Direction &dir)
   }
 }
 
-Block Chunk::operator[](const ivec3 &p)
+size_t Chunk::memory_usage() const
 {
-  // assert(in_range(p));
-  return blocks[ivec3_to_index(p)];
+  size_t size = ChunkData::memory_usage() + sizeof(Chunk) - sizeof(ChunkData);
+  if (render_state)
+    size += sizeof(ChunkRenderState) + render_state->size;
+  return size;
 }
 
-ivec3 Chunk::retrieve_chunk_coords(const ivec3 &p)
+bool Chunk::stage_mesh(StagingRing &ring)
 {
-  const int shift = glm::log2((float)CHUNKS_SIZE);
-  return ivec3(
-      (p.x >> shift) - (p.x < 0 ? 1 : 0),
-      0,
-      (p.z >> shift) - (p.z < 0 ? 1 : 0));
+  if (!ring.reserve(mesh_size(), staged))
+    return false;
+  // Same layout as in the mesh buffer, directions one after the other
+  uint8_t *out = staged.data;
+  for (int d = 0; d < DIRECTION_COUNT; d++)
+  {
+    const std::vector<uint32_t> &faces = mesh_data.faces[d];
+    memcpy(out, faces.data(), faces.size() * sizeof(uint32_t));
+    out += faces.size() * sizeof(uint32_t);
+  }
+  return true;
 }
 
-bool Chunk::chunk_exists(const ivec3 &chunk_coords, const unordered_map<ivec3, Chunk> &chunks)
+void Chunk::upload_to_gpu(MeshBuffer &buffer, StagingRing &ring)
 {
-  return chunks.find(chunk_coords) != chunks.end();
+  // The new mesh gets its own range, the previous one is drawn until both
+  // are swapped below
+  auto new_state = std::make_unique<ChunkRenderState>(buffer);
+  ChunkRenderState &state = *new_state;
+  state.size = mesh_size();
+  state.range = buffer.allocate(state.size);
+
+  int start = 0;
+  for (int d = 0; d < DIRECTION_COUNT; d++)
+  {
+    const std::vector<uint32_t> &faces = mesh_data.faces[d];
+    state.direction_start[d] = start;
+    for (int s = 0; s <= SECTIONS_COUNT; s++)
+      state.section_start[d][s] = mesh_data.section_start[d][s];
+    if (!faces.empty() && !staged.data)
+      buffer.write(state.range, start * sizeof(uint32_t), faces.data(),
+                   faces.size() * sizeof(uint32_t));
+    start += faces.size();
+  }
+  state.direction_start[DIRECTION_COUNT] = start;
+
+  if (staged.data)
+  {
+    ring.copy(staged, buffer.buffer(), buffer.offset(state.range));
+    staged = StagingRange();
+  }
+  // Frees the range of the previous mesh
+  render_state = std::move(new_state);
+  // The mesh buffer has its own copy now
+  mesh_data.free_faces();
 }
 
-std::optional<Block> Chunk::get_world_block(const ivec3 &world_pos, unordered_map<ivec3, Chunk> &chunks)
+void Chunk::release_render_state()
 {
-  ivec3 chunk_coords = retrieve_chunk_coords(world_pos);
-  if (!chunk_exists(chunk_coords, chunks))
-    return std::nullopt;
-
-  ivec3 local_pos = world_pos - chunk_coords * ivec3(CHUNKS_SIZE, 0, CHUNKS_SIZE);
-  if (local_pos.y < 0 || local_pos.y >= WORLD_HEIGHT)
-    return std::nullopt;
-
-  return chunks[chunk_coords][local_pos];
+  render_state.reset();
+  clear_mesh();
+  dirty = true;
 }
 
-void Chunk::prepare_mesh_data(const WorldGenerator &generator, const unordered_map<ivec3, Chunk> &chunks)
+int Chunk::get_draws(const Camera &camera, const Frustum &frustum, ChunkDraw *draws)
 {
-  static glm::ivec3 dir[]{
-      glm::ivec3(0, 0, 1),
-      glm::ivec3(0, 0, -1),
-      glm::ivec3(-1, 0, 0),
-      glm::ivec3(1, 0, 0),
-      glm::ivec3(0, -1, 0),
-      glm::ivec3(0, 1, 0),
-  };
-
-  if (active_count == 0)
-    return;
-  for (int d = (Direction)0; d < DIRECTION_COUNT; d++)
+  if (!render_state || render_state->range == MeshBuffer::NONE)
+    return 0;
+  const ChunkRenderState &state = *render_state;
+  // Face indices are in the whole buffer, gl_VertexID / 6 in the shader
+  int base = state.buffer.offset(state.range) / sizeof(uint32_t);
+  bool section_visible[SECTIONS_COUNT];
+  for (int s = 0; s < SECTIONS_COUNT; s++)
   {
-    mesh[d].faces_count = 0;
-    mesh[d].buffer.clear();
-    for (int x = 0; x < CHUNKS_SIZE; x++)
-    {
-      for (int y = 0; y < WORLD_HEIGHT; y++)
-      {
-        for (int z = 0; z < CHUNKS_SIZE; z++)
-        {
-          ivec3 p(x, y, z);
-          Block block = (*this)[p];
-          if (block.type != AIR)
-          {
-            ivec3 neigh = p + dir[d];
-
-            if (in_range(neigh))
-            {
-              if ((*this)[neigh].type != AIR && (*this)[neigh].type != LEAVES)
-                continue;
-            }
-            else
-            {
-              // This improves performance by 30%, but not reliable
-              if (generator.get_height(neigh.x, neigh.z, origin) > y)
-                continue;
+    vec3 min = vec3(origin) + vec3(0, s * SECTION_HEIGHT, 0);
+    vec3 max = min + vec3(CHUNKS_SIZE, SECTION_HEIGHT, CHUNKS_SIZE);
+    section_visible[s] = frustum.intersects(min, max);
+  }
 
-              // Convert local position to world position
-              // ivec3 world_pos = origin + neigh;
-              // auto neighbor_block = get_world_block(world_pos, chunks);
+  int n = 0;
+  for (int d = 0; d < 6; d++)
+  {
+    if (!player_sees_face(camera, (Direction)d))
+      continue;
 
-              // // Skip face creation if there's a block in the neighboring chunk
-              // if (neighbor_block.has_value() &&
-              //     neighbor_block.value().type != AIR &&
-              //     neighbor_block.value().type != LEAVES)
-              //   continue;
+    if (state.direction_start[d] == state.direction_start[d + 1])
+      continue;
 
-              // Don't render bottom face at y=0
-              if (y == 0 && d == (int)DOWN)
-                continue;
-            }
+    int direction_base = base + state.direction_start[d];
 
-            mesh[d].faces_count++;
-            set_face_at_coords(p, (Direction)d, block.type);
-          }
-        }
+    // Runs of consecutive visible sections, sections without faces have an
+    // empty range and don't break a run.
+    int s = 0;
+    while (s < SECTIONS_COUNT)
+    {
+      if (!section_visible[s])
+      {
+        s++;
+        continue;
       }
+      int first = state.section_start[d][s];
+      while (s < SECTIONS_COUNT && section_visible[s])
+        s++;
+      int count = state.section_start[d][s] - first;
+      if (count > 0)
+        draws[n++] = {d, direction_base + first, count};
     }
   }
+  return n;
 }
 
-void Chunk::set_face_at_coords(const vec3 &coords, const Direction &dir, const BlockType &type)
+void Chunk::render(const Camera &camera, const Frustum &frustum, Shader &shader)
 {
-  // TODO enlever la direction d'ici et en faire un autre ssbo chunk-wise
-  mesh[dir].buffer.push_back(
-      ivec4(coords.x, coords.y, coords.z, dir | type << 4));
-}
-
-void Chunk::upload_to_gpu()
-{
-  if (active_count == 0)
-    return;
-  for (int d = 0; d < 6; d++)
+  ChunkDraw draws[MAX_DRAWS];
+  int n = get_draws(camera, frustum, draws);
+  int direction = -1;
+  for (int i = 0; i < n; i++)
   {
-    mesh[d].ssbo.set_buffer(mesh[d].buffer.data(),
-                            mesh[d].buffer.size() * sizeof(ivec4), 0);
+    if (draws[i].direction != direction)
+    {
+      direction = draws[i].direction;
+      shader.uniform_int("faceDirection", direction);
+    }
+    glDrawArrays(GL_TRIANGLES, draws[i].first * 6, draws[i].count * 6);
   }
 }
 
-void Chunk::render(const Camera &camera)
+void Chunk::add_draws(const Camera &camera, const Frustum &frustum, MultiDrawBatch &batch)
 {
-  for (int d = 0; d < 6; d++)
-  {
-    if (!player_sees_face(camera, (Direction)d))
-      continue;
-
-    if (mesh[d].faces_count == 0)
-      continue;
-
-    mesh[d].vao.bind();
-    mesh[d].ssbo.bind(0);
-    glDrawArrays(GL_TRIANGLES, 0, mesh[d].buffer.size() * 6);
-  }
-}
\ No newline at end of file
+  ChunkDraw draws[MAX_DRAWS];
+  int n = get_draws(camera, frustum, draws);
+  for (int i = 0; i < n; i++)
+    batch.add(draws[i].first * 6, draws[i].count * 6, ivec4(origin, draws[i].direction));
+}
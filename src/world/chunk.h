@@ -6,9 +6,9 @@
 #include "glm/gtx/hash.hpp"
 
 #include "../params.h"
-#include "blocks.h"
-#include "world_generator.h"
+#include "chunk_data.h"
 
+#include <memory>
 #include <vector>
 #include <optional>
 #include <map>
@@ -16,81 +16,77 @@
 #include <thread>
 #include <future>
 
-enum Direction
+// Where a chunk's faces are in the MeshBuffer. Created by each upload,
+// on the thread holding the GL context, and released when replaced by the
+// next upload or when the chunk goes out of render distance.
+struct ChunkRenderState
 {
-  BACKWARD,
-  FORWARD,
-  LEFT,
-  RIGHT,
-  DOWN,
-  UP,
-  DIRECTION_COUNT
+  MeshBuffer &buffer;
+  MeshBuffer::Handle range = MeshBuffer::NONE;
+  // Directions are stored one after the other in the range, faces of
+  // direction d are in [direction_start[d], direction_start[d + 1]), and
+  // section by section like in ChunkMeshData
+  int direction_start[DIRECTION_COUNT + 1] = {0};
+  int section_start[DIRECTION_COUNT][SECTIONS_COUNT + 1] = {};
+  // Bytes of faces uploaded
+  size_t size = 0;
+
+  ChunkRenderState(MeshBuffer &buffer) : buffer(buffer) {}
+  ~ChunkRenderState() { buffer.free(range); }
 };
 
-struct ChunkMesh
+// Run of faces of one direction to draw, faces indexed in the whole mesh
+// buffer
+struct ChunkDraw
 {
-  vector<glm::ivec4> buffer;
-  VAO vao;
-  SSBO ssbo;
-  int faces_count = 0;
-  ChunkMesh() : ssbo(SSBO(nullptr, false)) { assert(false); }
-  ChunkMesh(Shader *shader) : vao(VAO()), ssbo(SSBO(shader, false)) {}
-  ~ChunkMesh() {}
+  int direction;
+  int first;
+  int count;
 };
 
-class Chunk
+// A chunk of the world: its blocks and CPU mesh, the state of its jobs, and
+// its range of the mesh buffer once uploaded. Chunks that were never
+// uploaded can be created and released from any thread.
+class Chunk : public ChunkData
 {
 public:
+  bool generating = false;
+  bool generated = false;
+  // The mesh is out of date. The previous one, if uploaded, is still drawn
+  // until the new one replaces it.
   bool dirty = true;
   bool meshing = false;
-  glm::ivec3 origin;
-  int active_count = 0;
-  ChunkMesh mesh[6];
-  int nb_blocks = CHUNKS_SIZE * WORLD_HEIGHT * CHUNKS_SIZE;
-  Block blocks[CHUNKS_SIZE * WORLD_HEIGHT * CHUNKS_SIZE];
+  // Last frame the chunk was in the frustum, for unloading
+  uint64_t last_visible_frame = 0;
+  // Null until the mesh is uploaded
+  std::unique_ptr<ChunkRenderState> render_state;
+  // Copy of the mesh in the staging ring, from the meshing job to the upload
+  StagingRange staged;
 
-  Chunk() { assert(false); }
-  Chunk(glm::ivec3 origin, Shader *shader)
-      : mesh{ChunkMesh(shader), ChunkMesh(shader), ChunkMesh(shader),
-             ChunkMesh(shader), ChunkMesh(shader), ChunkMesh(shader)}
-  {
-    this->origin = origin * glm::ivec3(CHUNKS_SIZE, 0, CHUNKS_SIZE);
-    dirty = true;
-  }
+  Chunk(const glm::ivec3 &coords) : ChunkData(coords) {}
   ~Chunk() {};
 
-  Block operator[](const glm::ivec3 &p);
+  // Approximate bytes used by the blocks and the mesh, on the CPU and GPU
+  size_t memory_usage() const;
   bool player_sees_face(const Camera &camera, const Direction &dir);
-  glm::ivec3 retrieve_chunk_coords(const glm::ivec3 &p);
-  // Check if a neighboring chunk exists
-  bool chunk_exists(const glm::ivec3 &chunk_coords, const unordered_map<glm::ivec3, Chunk> &chunks);
-  // Get a block from world coordinates, even if it's in another chunk
-  std::optional<Block> get_world_block(const glm::ivec3 &world_pos, unordered_map<glm::ivec3, Chunk> &chunks);
-  void prepare_mesh_data(const WorldGenerator &generator, const unordered_map<glm::ivec3, Chunk> &chunks);
-  void set_face_at_coords(const glm::vec3& coords, const Direction& dir, const BlockType& type);
-  void upload_to_gpu();
-  void render(const Camera &camera);
-
-private:
-  static glm::ivec3 index_to_ivec3(const int index)
-  {
-    int x = index % CHUNKS_SIZE;
-    int a = (index - x) / CHUNKS_SIZE;
-    int y = a % WORLD_HEIGHT;
-    int z = (a - y) / WORLD_HEIGHT;
-    return glm::ivec3(x, y, z);
-  }
-
-  static int ivec3_to_index(const glm::ivec3& p)
-  {
-    return p.z * CHUNKS_SIZE * WORLD_HEIGHT + p.y * CHUNKS_SIZE + p.x;
-  }
-
-  static bool in_range(const glm::ivec3& p)
-  {
-    return p.x >= 0 && p.y >= 0 && p.z >= 0 && p.x < CHUNKS_SIZE &&
-           p.y < WORLD_HEIGHT && p.z < CHUNKS_SIZE;
-  }
+  // Copy the mesh into the staging ring, from the meshing job. Returns false
+  // when the ring is full, the mesh is then written from the CPU mesh.
+  bool stage_mesh(StagingRing &ring);
+  // From the staging ring when staged, only issuing a GPU copy. Replaces
+  // the previous mesh once the new one is in the mesh buffer, and frees the
+  // faces of the CPU mesh.
+  void upload_to_gpu(MeshBuffer &buffer, StagingRing &ring);
+  // Free the mesh, on the GPU and the CPU, keeping the blocks. The chunk is
+  // meshed again before being rendered.
+  void release_render_state();
+  // Runs of visible faces, one per direction and run of consecutive
+  // sections in the frustum. Returns the number of draws written.
+  static const int MAX_DRAWS = DIRECTION_COUNT * ((SECTIONS_COUNT + 1) / 2);
+  int get_draws(const Camera &camera, const Frustum &frustum, ChunkDraw *draws);
+  // Draws from the mesh buffer, which must be bound
+  void render(const Camera &camera, const Frustum &frustum, Shader &shader);
+  // Adds the draws of the chunk to a batch, for the multi draw path
+  void add_draws(const Camera &camera, const Frustum &frustum, MultiDrawBatch &batch);
 };
 
-#endif
\ No newline at end of file
+#endif
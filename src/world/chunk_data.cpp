@@ -0,0 +1,31 @@
+#include "chunk_data.h"
+
+bool ChunkData::empty() const
+{
+  for (int s = 0; s < SECTIONS_COUNT; s++)
+  {
+    if (!sections[s].empty())
+      return false;
+  }
+  return true;
+}
+
+size_t ChunkData::memory_usage() const
+{
+  size_t size = sizeof(ChunkData);
+  for (int s = 0; s < SECTIONS_COUNT; s++)
+    size += sections[s].blocks.memory_usage();
+  size += mesh_data.capacity();
+  return size;
+}
+
+void ChunkData::clear_blocks()
+{
+  for (int s = 0; s < SECTIONS_COUNT; s++)
+    sections[s] = ChunkSection();
+}
+
+void ChunkData::clear_mesh()
+{
+  mesh_data = ChunkMeshData();
+}
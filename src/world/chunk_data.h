@@ -0,0 +1,54 @@
+#ifndef CHUNK_DATA_H
+#define CHUNK_DATA_H
+
+#include <glm/glm.hpp>
+
+#include "../params.h"
+#include "blocks.h"
+#include "chunk_section.h"
+#include "chunk_mesher.h"
+#include "../jobs/cancellation_token.h"
+
+// Blocks of a chunk and their CPU mesh. Holds no GL object, so it can be
+// created on any thread, and used by tools that have no window.
+class ChunkData
+{
+public:
+  glm::ivec3 origin;
+  ChunkSection sections[SECTIONS_COUNT];
+  // Faces built by the last meshing, until they are uploaded
+  ChunkMeshData mesh_data;
+
+  ChunkData(const glm::ivec3 &coords)
+      : origin(coords * glm::ivec3(CHUNKS_SIZE, 0, CHUNKS_SIZE)) {}
+
+  Block operator[](const glm::ivec3 &p) const
+  {
+    return Block{sections[p.y / SECTION_HEIGHT].get(
+        glm::ivec3(p.x, p.y % SECTION_HEIGHT, p.z))};
+  }
+
+  bool empty() const;
+  // Approximate bytes used by the blocks and the CPU mesh
+  size_t memory_usage() const;
+  // Drop the blocks of a partially generated chunk
+  void clear_blocks();
+  // Drop the CPU mesh and free its memory
+  void clear_mesh();
+  // Copy the blocks of this chunk's side facing dir, as laid out in
+  // ChunkBorders
+  void copy_border(const Direction &dir, uint8_t *out) const
+  {
+    ChunkMesher::copy_border(sections, dir, out);
+  }
+  // Returns false if cancelled before the end, leaving the mesh incomplete
+  bool prepare_mesh_data(const ChunkBorders &borders, MeshingMode mode = MESHING_GREEDY,
+                         const CancellationToken *token = nullptr)
+  {
+    return ChunkMesher(sections, mesh_data).mesh(borders, mode, token);
+  }
+  // Size in bytes of the faces of all directions
+  size_t mesh_size() const { return mesh_data.size(); }
+};
+
+#endif
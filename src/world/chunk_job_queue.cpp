@@ -0,0 +1,30 @@
+#include "chunk_job_queue.h"
+#include <algorithm>
+
+static bool lower_priority(const ChunkJobRequest &a, const ChunkJobRequest &b)
+{
+  return a.priority > b.priority;
+}
+
+float ChunkJobQueue::priority(float dist_sq, bool visible, int render_distance)
+{
+  if (visible)
+    return dist_sq;
+  return dist_sq + (float)(render_distance * render_distance);
+}
+
+void ChunkJobQueue::push(const glm::ivec3 &coords, float priority)
+{
+  heap.push_back({coords, priority});
+  std::push_heap(heap.begin(), heap.end(), lower_priority);
+}
+
+bool ChunkJobQueue::pop(glm::ivec3 &coords)
+{
+  if (heap.empty())
+    return false;
+  std::pop_heap(heap.begin(), heap.end(), lower_priority);
+  coords = heap.back().coords;
+  heap.pop_back();
+  return true;
+}
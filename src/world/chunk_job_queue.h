@@ -0,0 +1,33 @@
+#ifndef CHUNK_JOB_QUEUE_H
+#define CHUNK_JOB_QUEUE_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+struct ChunkJobRequest
+{
+  glm::ivec3 coords;
+  float priority;
+};
+
+// Chunks waiting for a generation or meshing job, lowest priority first.
+// The queue is rebuilt from scratch whenever priorities change (camera
+// moved, jobs finished) rather than updated in place.
+class ChunkJobQueue
+{
+public:
+  // Priority of a chunk: its squared distance to the player, chunks outside
+  // of the frustum coming after all visible ones
+  static float priority(float dist_sq, bool visible, int render_distance);
+
+  void clear() { heap.clear(); }
+  bool empty() const { return heap.empty(); }
+  int size() const { return (int)heap.size(); }
+  void push(const glm::ivec3 &coords, float priority);
+  bool pop(glm::ivec3 &coords);
+
+private:
+  std::vector<ChunkJobRequest> heap;
+};
+
+#endif
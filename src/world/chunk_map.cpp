@@ -0,0 +1,47 @@
+#include "chunk_map.h"
+
+using namespace glm;
+
+int ChunkMap::shard_index(const ivec3 &coords)
+{
+  // Neighbouring chunks land in different shards
+  return ((coords.x & 3) | (coords.z & 3) << 2) % SHARDS_COUNT;
+}
+
+ChunkHandle ChunkMap::find(const ivec3 &coords) const
+{
+  const Shard &s = shard(coords);
+  std::shared_lock lock(s.mutex);
+  auto it = s.chunks.find(coords);
+  return it == s.chunks.end() ? nullptr : it->second;
+}
+
+ChunkHandle ChunkMap::find_or_create(const ivec3 &coords)
+{
+  Shard &s = shard(coords);
+  {
+    std::shared_lock lock(s.mutex);
+    auto it = s.chunks.find(coords);
+    if (it != s.chunks.end())
+      return it->second;
+  }
+
+  std::unique_lock lock(s.mutex);
+  ChunkHandle &chunk = s.chunks[coords];
+  if (!chunk)
+  {
+    chunk = std::make_shared<Chunk>(coords);
+    count.fetch_add(1, std::memory_order_relaxed);
+  }
+  return chunk;
+}
+
+bool ChunkMap::erase(const ivec3 &coords)
+{
+  Shard &s = shard(coords);
+  std::unique_lock lock(s.mutex);
+  if (s.chunks.erase(coords) == 0)
+    return false;
+  count.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
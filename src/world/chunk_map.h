@@ -0,0 +1,94 @@
+#ifndef CHUNK_MAP_H
+#define CHUNK_MAP_H
+
+#include "chunk.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+// Chunks are shared between the map and the jobs working on them: a chunk
+// removed from the map stays alive until its last job is over.
+using ChunkHandle = std::shared_ptr<Chunk>;
+
+// Chunks by chunk coordinates, split into shards that each have their own
+// lock so that lookups from any thread don't race with the main thread
+// loading or unloading chunks. Handles stay valid across inserts and
+// removals.
+class ChunkMap
+{
+public:
+  ChunkMap() {}
+  ChunkMap(const ChunkMap &) = delete;
+  ChunkMap &operator=(const ChunkMap &) = delete;
+
+  // Null if the chunk is not loaded
+  ChunkHandle find(const glm::ivec3 &coords) const;
+  // Returns the chunk at coords, created if it is not loaded
+  ChunkHandle find_or_create(const glm::ivec3 &coords);
+  bool erase(const glm::ivec3 &coords);
+  size_t size() const { return count.load(std::memory_order_relaxed); }
+
+  // Calls f(i, handle) for every coords[i] that is loaded, locking each
+  // shard once. f must not access the map.
+  template <typename F>
+  void find_each(const glm::ivec3 *coords, int n, F &&f) const
+  {
+    // Indices of the coordinates grouped by shard
+    std::vector<int> order(n);
+    int start[SHARDS_COUNT + 1] = {};
+    for (int i = 0; i < n; i++)
+      start[shard_index(coords[i]) + 1]++;
+    for (int s = 0; s < SHARDS_COUNT; s++)
+      start[s + 1] += start[s];
+    int next[SHARDS_COUNT];
+    std::copy(start, start + SHARDS_COUNT, next);
+    for (int i = 0; i < n; i++)
+      order[next[shard_index(coords[i])]++] = i;
+
+    for (int s = 0; s < SHARDS_COUNT; s++)
+    {
+      const Shard &shard = shards[s];
+      std::shared_lock lock(shard.mutex);
+      for (int k = start[s]; k < start[s + 1]; k++)
+      {
+        auto it = shard.chunks.find(coords[order[k]]);
+        if (it != shard.chunks.end())
+          f(order[k], it->second);
+      }
+    }
+  }
+
+  // Calls f(coords, handle) on every chunk, one shard at a time. f must not
+  // access the map.
+  template <typename F>
+  void for_each(F &&f) const
+  {
+    for (const Shard &shard : shards)
+    {
+      std::shared_lock lock(shard.mutex);
+      for (const auto &[coords, chunk] : shard.chunks)
+        f(coords, chunk);
+    }
+  }
+
+private:
+  static const int SHARDS_COUNT = 16;
+
+  struct Shard
+  {
+    mutable std::shared_mutex mutex;
+    unordered_map<glm::ivec3, ChunkHandle> chunks;
+  };
+
+  Shard shards[SHARDS_COUNT];
+  std::atomic<size_t> count{0};
+
+  Shard &shard(const glm::ivec3 &coords) { return shards[shard_index(coords)]; }
+  const Shard &shard(const glm::ivec3 &coords) const { return shards[shard_index(coords)]; }
+  static int shard_index(const glm::ivec3 &coords);
+};
+
+#endif
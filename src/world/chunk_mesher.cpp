@@ -0,0 +1,334 @@
+#include "chunk_mesher.h"
+#include <cstring>
+
+using namespace glm;
+
+// Sections are meshed from a padded copy laid out like ChunkSection (y
+// contiguous, then x, then z), so that every neighbour is at a fixed offset
+// from the current block.
+static const int PAD_X = CHUNKS_SIZE + 2;
+static const int PAD_Y = SECTION_HEIGHT + 2;
+static const int PAD_Z = CHUNKS_SIZE + 2;
+
+// Stands for the blocks below the world, that hide bottom faces
+static const uint8_t SOLID = STONE;
+
+static const int neighbour_offset[DIRECTION_COUNT]{
+    PAD_Y * PAD_X,  // BACKWARD
+    -PAD_Y * PAD_X, // FORWARD
+    -PAD_Y,         // LEFT
+    PAD_Y,          // RIGHT
+    -1,             // DOWN
+    1,              // UP
+};
+
+static int padded_index(int x, int y, int z)
+{
+  return (y + 1) + PAD_Y * ((x + 1) + PAD_X * (z + 1));
+}
+
+// Axes (0: x, 1: y, 2: z) spanned by the faces of each direction: u is the
+// texture's horizontal axis, v its vertical axis, n the face normal.
+static const int axis_u[DIRECTION_COUNT]{0, 0, 2, 2, 0, 0};
+static const int axis_v[DIRECTION_COUNT]{1, 1, 1, 1, 2, 2};
+static const int axis_n[DIRECTION_COUNT]{2, 2, 0, 0, 1, 1};
+static const int section_dims[3]{CHUNKS_SIZE, SECTION_HEIGHT, CHUNKS_SIZE};
+static const int section_stride[3]{SECTION_HEIGHT, 1, CHUNKS_SIZE * SECTION_HEIGHT};
+
+bool ChunkMesher::section_buried(int s) const
+{
+  // Bottom faces at y=0 are never rendered, so the world floor counts as
+  // covering the lowest section.
+  return sections[s].full() &&
+         (s == 0 || sections[s - 1].full()) &&
+         (s + 1 < SECTIONS_COUNT && sections[s + 1].full());
+}
+
+void ChunkMesher::copy_border(const ChunkSection *sections, const Direction &dir, uint8_t *out)
+{
+  for (int i = 0; i < CHUNKS_SIZE; i++)
+  {
+    ivec2 column;
+    switch (dir)
+    {
+    case BACKWARD:
+      column = ivec2(i, CHUNKS_SIZE - 1);
+      break;
+    case FORWARD:
+      column = ivec2(i, 0);
+      break;
+    case LEFT:
+      column = ivec2(0, i);
+      break;
+    case RIGHT:
+      column = ivec2(CHUNKS_SIZE - 1, i);
+      break;
+    default:
+      assert(false);
+    }
+
+    for (int s = 0; s < SECTIONS_COUNT; s++)
+      sections[s].blocks.unpack(ChunkSection::column_index(column.x, column.y), SECTION_HEIGHT,
+                                out + i * WORLD_HEIGHT + s * SECTION_HEIGHT);
+  }
+}
+
+void ChunkMesher::fill_padded_section(int s, const ChunkBorders &borders, uint8_t *padded) const
+{
+  const ChunkSection &section = sections[s];
+  int base_y = s * SECTION_HEIGHT;
+  memset(padded, AIR, PAD_X * PAD_Y * PAD_Z);
+
+  for (int z = 0; z < CHUNKS_SIZE; z++)
+  {
+    for (int x = 0; x < CHUNKS_SIZE; x++)
+    {
+      section.blocks.unpack(ChunkSection::column_index(x, z), SECTION_HEIGHT,
+                            padded + padded_index(x, 0, z));
+
+      // Below: the previous section, bottom faces at y=0 are never rendered
+      padded[padded_index(x, -1, z)] =
+          s == 0 ? (uint8_t)SOLID
+                 : (uint8_t)sections[s - 1].get(ivec3(x, SECTION_HEIGHT - 1, z));
+      // Above: the next section, air above the world
+      if (s + 1 < SECTIONS_COUNT)
+        padded[padded_index(x, SECTION_HEIGHT, z)] = sections[s + 1].get(ivec3(x, 0, z));
+    }
+  }
+
+  // Sides: columns of the neighbouring chunks, contiguous in y on both sides
+  for (int i = 0; i < CHUNKS_SIZE; i++)
+  {
+    int y = i * WORLD_HEIGHT + base_y;
+    memcpy(padded + padded_index(i, 0, CHUNKS_SIZE), borders.blocks[BACKWARD] + y, SECTION_HEIGHT);
+    memcpy(padded + padded_index(i, 0, -1), borders.blocks[FORWARD] + y, SECTION_HEIGHT);
+    memcpy(padded + padded_index(-1, 0, i), borders.blocks[LEFT] + y, SECTION_HEIGHT);
+    memcpy(padded + padded_index(CHUNKS_SIZE, 0, i), borders.blocks[RIGHT] + y, SECTION_HEIGHT);
+  }
+}
+
+bool ChunkMesher::mesh(const ChunkBorders &borders, MeshingMode mode,
+                       const CancellationToken *token)
+{
+  static thread_local std::vector<uint8_t> padded(PAD_X * PAD_Y * PAD_Z);
+
+  out.clear();
+  bool empty = true;
+  for (int s = 0; s < SECTIONS_COUNT; s++)
+    empty &= sections[s].empty();
+  if (empty)
+    return true;
+
+  for (int s = 0; s < SECTIONS_COUNT; s++)
+  {
+    if (token && token->cancelled())
+      return false;
+
+    for (int d = 0; d < DIRECTION_COUNT; d++)
+      out.section_start[d][s] = out.faces[d].size();
+    if (sections[s].empty())
+      continue;
+
+    fill_padded_section(s, borders, padded.data());
+    if (mode == MESHING_GREEDY)
+      mesh_section_greedy(s, padded.data());
+    else if (mode == MESHING_BINARY)
+      mesh_section_binary(s, padded.data());
+    else
+      mesh_section(s, padded.data());
+  }
+
+  for (int d = 0; d < DIRECTION_COUNT; d++)
+    out.section_start[d][SECTIONS_COUNT] = out.faces[d].size();
+  return true;
+}
+
+void ChunkMesher::mesh_section(int s, const uint8_t *padded)
+{
+  bool buried = section_buried(s);
+  int base_y = s * SECTION_HEIGHT;
+
+  // Single pass in memory order, emitting the faces of all six directions
+  for (int z = 0; z < CHUNKS_SIZE; z++)
+  {
+    for (int x = 0; x < CHUNKS_SIZE; x++)
+    {
+      // Only the columns on the chunk sides of a buried section can have
+      // visible faces
+      if (buried && x > 0 && x < CHUNKS_SIZE - 1 && z > 0 && z < CHUNKS_SIZE - 1)
+        continue;
+
+      int i = padded_index(x, 0, z);
+      for (int y = 0; y < SECTION_HEIGHT; y++, i++)
+      {
+        BlockType type = (BlockType)padded[i];
+        if (type == AIR)
+          continue;
+
+        for (int d = 0; d < DIRECTION_COUNT; d++)
+        {
+          if (is_occluding((BlockType)padded[i + neighbour_offset[d]]))
+            continue;
+          add_face(ivec3(x, base_y + y, z), (Direction)d, type);
+        }
+      }
+    }
+  }
+}
+
+void ChunkMesher::mesh_section_greedy(int s, const uint8_t *padded)
+{
+  // Type of the visible face of each block, per direction, AIR where hidden
+  static thread_local std::vector<uint8_t> faces(DIRECTION_COUNT * ChunkSection::volume);
+  memset(faces.data(), AIR, faces.size());
+
+  bool buried = section_buried(s);
+  int base_y = s * SECTION_HEIGHT;
+
+  // Same pass as mesh_section, recording faces instead of emitting them
+  for (int z = 0; z < CHUNKS_SIZE; z++)
+  {
+    for (int x = 0; x < CHUNKS_SIZE; x++)
+    {
+      if (buried && x > 0 && x < CHUNKS_SIZE - 1 && z > 0 && z < CHUNKS_SIZE - 1)
+        continue;
+
+      int i = padded_index(x, 0, z);
+      int j = ChunkSection::column_index(x, z);
+      for (int y = 0; y < SECTION_HEIGHT; y++, i++, j++)
+      {
+        uint8_t type = padded[i];
+        if (type == AIR)
+          continue;
+
+        for (int d = 0; d < DIRECTION_COUNT; d++)
+        {
+          if (!is_occluding((BlockType)padded[i + neighbour_offset[d]]))
+            faces[d * ChunkSection::volume + j] = type;
+        }
+      }
+    }
+  }
+
+  // Merge each slice of faces into rectangles: grow along u as long as the
+  // type matches, then along v as long as the whole row matches.
+  for (int d = 0; d < DIRECTION_COUNT; d++)
+  {
+    uint8_t *f = faces.data() + d * ChunkSection::volume;
+    int nu = section_dims[axis_u[d]], nv = section_dims[axis_v[d]], nn = section_dims[axis_n[d]];
+    int su = section_stride[axis_u[d]], sv = section_stride[axis_v[d]], sn = section_stride[axis_n[d]];
+
+    for (int n = 0; n < nn; n++)
+    {
+      for (int v = 0; v < nv; v++)
+      {
+        for (int u = 0; u < nu; u++)
+        {
+          int i = n * sn + v * sv + u * su;
+          uint8_t type = f[i];
+          if (type == AIR)
+            continue;
+
+          int width = 1;
+          while (u + width < nu && width < MAX_FACE_SIZE && f[i + width * su] == type)
+            width++;
+
+          int height = 1;
+          for (; v + height < nv && height < MAX_FACE_SIZE; height++)
+          {
+            int row = i + height * sv;
+            int k = 0;
+            while (k < width && f[row + k * su] == type)
+              k++;
+            if (k < width)
+              break;
+          }
+
+          for (int h = 0; h < height; h++)
+            for (int k = 0; k < width; k++)
+              f[i + h * sv + k * su] = AIR;
+
+          // Quads extend towards +x, +y and -z from their anchor block, see
+          // vertex_positions in default.vert
+          ivec3 anchor;
+          anchor[axis_n[d]] = n;
+          anchor[axis_u[d]] = u;
+          anchor[axis_v[d]] = v;
+          if (axis_u[d] == 2)
+            anchor.z += width - 1;
+          if (axis_v[d] == 2)
+            anchor.z += height - 1;
+          anchor.y += base_y;
+
+          add_face(anchor, (Direction)d, (BlockType)type, width, height);
+        }
+      }
+    }
+  }
+}
+
+void ChunkMesher::mesh_section_binary(int s, const uint8_t *padded)
+{
+  static_assert(PAD_Y <= 64, "a padded section column must fit in 64 bits");
+
+  // One bit per block of each padded column, bit b is y = b - 1
+  uint64_t solid[PAD_X * PAD_Z];
+  uint64_t occluding[PAD_X * PAD_Z];
+  for (int c = 0; c < PAD_X * PAD_Z; c++)
+  {
+    const uint8_t *column = padded + c * PAD_Y;
+    uint64_t s_bits = 0, o_bits = 0;
+    for (int b = 0; b < PAD_Y; b++)
+    {
+      s_bits |= (uint64_t)(column[b] != AIR) << b;
+      o_bits |= (uint64_t)is_occluding((BlockType)column[b]) << b;
+    }
+    solid[c] = s_bits;
+    occluding[c] = o_bits;
+  }
+
+  const uint64_t inside = ((1ull << SECTION_HEIGHT) - 1) << 1;
+  bool buried = section_buried(s);
+  int base_y = s * SECTION_HEIGHT;
+
+  // Columns and directions are visited in the same order as mesh_section,
+  // so that both produce identical buffers.
+  for (int z = 0; z < CHUNKS_SIZE; z++)
+  {
+    for (int x = 0; x < CHUNKS_SIZE; x++)
+    {
+      if (buried && x > 0 && x < CHUNKS_SIZE - 1 && z > 0 && z < CHUNKS_SIZE - 1)
+        continue;
+
+      int c = (x + 1) + PAD_X * (z + 1);
+      uint64_t self = solid[c] & inside;
+      if (self == 0)
+        continue;
+
+      uint64_t visible[DIRECTION_COUNT]{
+          self & ~occluding[c + PAD_X], // BACKWARD
+          self & ~occluding[c - PAD_X], // FORWARD
+          self & ~occluding[c - 1],     // LEFT
+          self & ~occluding[c + 1],     // RIGHT
+          self & ~(occluding[c] << 1),  // DOWN
+          self & ~(occluding[c] >> 1),  // UP
+      };
+
+      const uint8_t *column = padded + c * PAD_Y;
+      for (int d = 0; d < DIRECTION_COUNT; d++)
+      {
+        for (uint64_t bits = visible[d]; bits != 0; bits &= bits - 1)
+        {
+          int b = __builtin_ctzll(bits);
+          add_face(ivec3(x, base_y + b - 1, z), (Direction)d, (BlockType)column[b]);
+        }
+      }
+    }
+  }
+}
+
+void ChunkMesher::add_face(const ivec3 &coords, const Direction &dir, const BlockType &type,
+                           int width, int height)
+{
+  out.faces[dir].push_back(pack_face(coords, type, width, height));
+}
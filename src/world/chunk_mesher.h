@@ -0,0 +1,135 @@
+#ifndef CHUNK_MESHER_H
+#define CHUNK_MESHER_H
+
+#include "../params.h"
+#include "blocks.h"
+#include "chunk_section.h"
+#include "../jobs/cancellation_token.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Builds the faces of a chunk from its blocks, on the CPU only: no OpenGL
+// here, so that the mesher can run in tools without a window.
+
+enum Direction
+{
+  BACKWARD,
+  FORWARD,
+  LEFT,
+  RIGHT,
+  DOWN,
+  UP,
+  DIRECTION_COUNT
+};
+
+enum MeshingMode
+{
+  // One quad per visible block face
+  MESHING_NAIVE,
+  // Coplanar faces of the same block type merged into rectangles
+  MESHING_GREEDY,
+  // Same output as MESHING_NAIVE, computed on 64-bit column occupancy masks
+  MESHING_BINARY,
+};
+
+// Faces are packed in 32 bits, from the lowest bit: x (5), y (7), z (5),
+// block type (7), width - 1 (4) and height - 1 (4) of merged faces. The
+// direction is implied by the mesh the face is stored in.
+const int MAX_FACE_SIZE = 16;
+static_assert(CHUNKS_SIZE <= 32 && WORLD_HEIGHT <= 128,
+              "face coordinates are packed on 5 and 7 bits");
+
+inline uint32_t pack_face(const glm::ivec3 &p, BlockType type, int width, int height)
+{
+  return (uint32_t)p.x | (uint32_t)p.y << 5 | (uint32_t)p.z << 12 |
+         (uint32_t)type << 17 | (uint32_t)(width - 1) << 24 |
+         (uint32_t)(height - 1) << 28;
+}
+
+// Copy of the blocks of the four neighbouring chunks that touch a chunk,
+// taken on the main thread when meshing is scheduled, so that the mesher
+// culls border faces exactly without reading other chunks from a worker.
+struct ChunkBorders
+{
+  // Indexed by the side of the meshed chunk (BACKWARD, FORWARD, LEFT,
+  // RIGHT), then [i * WORLD_HEIGHT + y] with i along the border: x for
+  // BACKWARD and FORWARD, z for LEFT and RIGHT.
+  uint8_t blocks[4][CHUNKS_SIZE * WORLD_HEIGHT];
+};
+
+// Packed faces of a chunk, one list per direction
+struct ChunkMeshData
+{
+  std::vector<uint32_t> faces[DIRECTION_COUNT];
+  // Faces are stored section by section, faces of section s are in
+  // [section_start[d][s], section_start[d][s + 1])
+  int section_start[DIRECTION_COUNT][SECTIONS_COUNT + 1] = {};
+
+  // Size in bytes of the faces of all directions
+  size_t size() const
+  {
+    size_t size = 0;
+    for (int d = 0; d < DIRECTION_COUNT; d++)
+      size += faces[d].size() * sizeof(uint32_t);
+    return size;
+  }
+
+  size_t capacity() const
+  {
+    size_t capacity = 0;
+    for (int d = 0; d < DIRECTION_COUNT; d++)
+      capacity += faces[d].capacity() * sizeof(uint32_t);
+    return capacity;
+  }
+
+  // Free the faces once uploaded, keeping where sections start
+  void free_faces()
+  {
+    for (int d = 0; d < DIRECTION_COUNT; d++)
+      std::vector<uint32_t>().swap(faces[d]);
+  }
+
+  void clear()
+  {
+    for (int d = 0; d < DIRECTION_COUNT; d++)
+    {
+      faces[d].clear();
+      for (int s = 0; s <= SECTIONS_COUNT; s++)
+        section_start[d][s] = 0;
+    }
+  }
+};
+
+class ChunkMesher
+{
+public:
+  ChunkMesher(const ChunkSection *sections, ChunkMeshData &out) : sections(sections), out(out) {}
+
+  // Copy the blocks of a chunk's side facing dir, as laid out in
+  // ChunkBorders
+  static void copy_border(const ChunkSection *sections, const Direction &dir, uint8_t *out);
+  // Returns false if cancelled before the end, leaving the mesh incomplete
+  bool mesh(const ChunkBorders &borders, MeshingMode mode = MESHING_GREEDY,
+            const CancellationToken *token = nullptr);
+
+private:
+  const ChunkSection *sections;
+  ChunkMeshData &out;
+
+  // A section is buried when it is filled with occluding blocks and so are
+  // the sections above and below it: only its faces on the chunk sides can
+  // be visible.
+  bool section_buried(int s) const;
+  // Copy section s into a (CHUNKS_SIZE + 2) x (SECTION_HEIGHT + 2) x
+  // (CHUNKS_SIZE + 2) buffer, with a one block border taken from the
+  // neighbouring sections and chunks.
+  void fill_padded_section(int s, const ChunkBorders &borders, uint8_t *padded) const;
+  void mesh_section(int s, const uint8_t *padded);
+  void mesh_section_greedy(int s, const uint8_t *padded);
+  void mesh_section_binary(int s, const uint8_t *padded);
+  void add_face(const glm::ivec3 &coords, const Direction &dir, const BlockType &type,
+                int width = 1, int height = 1);
+};
+
+#endif
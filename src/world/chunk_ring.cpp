@@ -0,0 +1,78 @@
+#include "chunk_ring.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace glm;
+
+ChunkRing::ChunkRing(int radius)
+{
+  for (int x = -radius; x < radius; x++)
+    for (int z = -radius; z < radius; z++)
+    {
+      if (x * x + z * z < radius * radius)
+        offsets.push_back(ivec3(x, 0, z));
+    }
+  std::stable_sort(offsets.begin(), offsets.end(), [](const ivec3 &a, const ivec3 &b)
+                   { return a.x * a.x + a.z * a.z < b.x * b.x + b.z * b.z; });
+  for (const ivec3 &offset : offsets)
+    distances.push_back(offset.x * offset.x + offset.z * offset.z);
+  coords.resize(offsets.size());
+  center_x.resize(offsets.size());
+  center_z.resize(offsets.size());
+  inside.resize(offsets.size());
+}
+
+void ChunkRing::recenter(const ivec3 &new_center)
+{
+  if (centered && new_center == center)
+    return;
+  center = new_center;
+  centered = true;
+  culled = false;
+  for (size_t i = 0; i < offsets.size(); i++)
+  {
+    coords[i] = center + offsets[i];
+    // Same as the center of the box from Frustum::intersects
+    vec3 min = vec3(coords[i] * CHUNKS_SIZE);
+    vec3 max = min + vec3(CHUNKS_SIZE, WORLD_HEIGHT, CHUNKS_SIZE);
+    center_x[i] = (min.x + max.x) * 0.5f;
+    center_z[i] = (min.z + max.z) * 0.5f;
+  }
+}
+
+void ChunkRing::cull(const Frustum &frustum, std::vector<std::pair<ivec3, float>> &visible)
+{
+  const vec3 extents = vec3(CHUNKS_SIZE, WORLD_HEIGHT, CHUNKS_SIZE) * 0.5f;
+  const float center_y = WORLD_HEIGHT * 0.5f;
+  size_t n = offsets.size();
+  std::fill(inside.begin(), inside.end(), 1);
+  // Plane by plane over every box, the inner loop has no branch
+  for (int p = 0; p < 6; p++)
+  {
+    const vec4 &plane = frustum.planes[p];
+    float radius = extents.x * std::abs(plane.x) +
+                   extents.y * std::abs(plane.y) +
+                   extents.z * std::abs(plane.z);
+    float limit = -radius - Frustum::EPSILON;
+    float y = plane.y * center_y;
+    const float *cx = center_x.data();
+    const float *cz = center_z.data();
+    uint8_t *in = inside.data();
+    for (size_t i = 0; i < n; i++)
+    {
+      float distance = plane.x * cx[i] + y + plane.z * cz[i] + plane.w;
+      in[i] &= !(distance < limit);
+    }
+  }
+  // The player's chunk comes first
+  inside[0] = 1;
+
+  visible.clear();
+  for (size_t i = 0; i < n; i++)
+  {
+    if (inside[i])
+      visible.emplace_back(coords[i], distances[i]);
+  }
+  last_frustum = frustum;
+  culled = true;
+}
@@ -0,0 +1,51 @@
+#ifndef CHUNK_RING_H
+#define CHUNK_RING_H
+
+#include "../params.h"
+#include "../gfx/frustum.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Chunks within a radius of the player's chunk, sorted by distance, with
+// their bounding boxes laid out one array per coordinate so that they are
+// all tested against the frustum in one pass. The offsets are sorted once,
+// the boxes are only moved when the player changes chunk and the frustum
+// test only runs again when the frustum changes.
+class ChunkRing
+{
+public:
+  explicit ChunkRing(int radius);
+
+  void recenter(const glm::ivec3 &center);
+  // Whether the last cull was done with this frustum and the current center
+  bool culled_with(const Frustum &frustum) const { return culled && frustum == last_frustum; }
+  // The chunks intersecting the frustum with their squared distance to the
+  // center, closest first. The center chunk is always part of them.
+  void cull(const Frustum &frustum, std::vector<std::pair<glm::ivec3, float>> &visible);
+  int size() const { return (int)offsets.size(); }
+  // Candidate i, closest first, and its squared distance to the center
+  const glm::ivec3 *candidates() const { return coords.data(); }
+  float distance(int i) const { return distances[i]; }
+  // Whether candidate i passed the last cull
+  bool visible(int i) const { return inside[i]; }
+
+private:
+  glm::ivec3 center = glm::ivec3(0);
+  bool centered = false;
+  Frustum last_frustum;
+  bool culled = false;
+  // Offsets from the center and squared distances, closest first
+  std::vector<glm::ivec3> offsets;
+  std::vector<float> distances;
+  // center + offsets
+  std::vector<glm::ivec3> coords;
+  // Centers of the boxes in world coordinates. Boxes all have the size of a
+  // chunk, the same extents.
+  std::vector<float> center_x;
+  std::vector<float> center_z;
+  std::vector<uint8_t> inside;
+};
+
+#endif
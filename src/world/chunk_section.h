@@ -0,0 +1,58 @@
+#ifndef CHUNK_SECTION_H
+#define CHUNK_SECTION_H
+
+#include <glm/glm.hpp>
+
+#include "../params.h"
+#include "blocks.h"
+#include "palette_storage.h"
+
+// A vertical slice of a chunk, CHUNKS_SIZE x SECTION_HEIGHT x CHUNKS_SIZE
+// blocks, with its own palette. Sections count their non-air and occluding
+// blocks so that empty and fully buried sections can be skipped by the
+// generator, the mesher and the renderer.
+class ChunkSection
+{
+public:
+  static const int volume = CHUNKS_SIZE * SECTION_HEIGHT * CHUNKS_SIZE;
+  PaletteStorage blocks;
+  int active_count = 0;
+  int occluding_count = 0;
+
+  ChunkSection() : blocks(volume) {}
+  ~ChunkSection() {}
+
+  BlockType get(const glm::ivec3 &p) const
+  {
+    return blocks.get(ivec3_to_index(p));
+  }
+
+  void set(const glm::ivec3 &p, BlockType type)
+  {
+    int index = ivec3_to_index(p);
+    BlockType previous = blocks.get(index);
+    if (previous == type)
+      return;
+    active_count += (type != AIR) - (previous != AIR);
+    occluding_count += is_occluding(type) - is_occluding(previous);
+    blocks.set(index, type);
+  }
+
+  bool empty() const { return active_count == 0; }
+  bool full() const { return occluding_count == volume; }
+
+  // Blocks are stored column by column: y is the contiguous axis, then x,
+  // then z. The generator fills columns bottom to top and the mesher walks
+  // them in the same order.
+  static int ivec3_to_index(const glm::ivec3 &p)
+  {
+    return column_index(p.x, p.z) + p.y;
+  }
+
+  static int column_index(int x, int z)
+  {
+    return (z * CHUNKS_SIZE + x) * SECTION_HEIGHT;
+  }
+};
+
+#endif
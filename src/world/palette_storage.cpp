@@ -0,0 +1,77 @@
+#include "palette_storage.h"
+#include <cstring>
+
+PaletteStorage::PaletteStorage(int size) : count(size)
+{
+  palette.push_back(AIR);
+}
+
+size_t PaletteStorage::memory_usage() const
+{
+  return sizeof(PaletteStorage) + palette.capacity() * sizeof(BlockType) +
+         data.capacity() * sizeof(uint64_t);
+}
+
+void PaletteStorage::unpack(int start, int n, uint8_t *out) const
+{
+  if (bits == 0)
+  {
+    memset(out, palette[0], n);
+    return;
+  }
+
+  // Stream through the words instead of recomputing the position of each
+  // index, widths are powers of two so indices never straddle words
+  size_t bit = (size_t)start * bits;
+  size_t w = bit >> 6;
+  int shift = bit & 63;
+  uint64_t word = data[w] >> shift;
+  for (int i = 0; i < n; i++)
+  {
+    out[i] = (uint8_t)palette[word & mask()];
+    word >>= bits;
+    shift += bits;
+    if (shift == 64 && i + 1 < n)
+    {
+      word = data[++w];
+      shift = 0;
+    }
+  }
+}
+
+int PaletteStorage::find_or_add(BlockType type)
+{
+  // Palettes hold a handful of types, a linear scan beats any lookup table
+  for (int i = 0; i < (int)palette.size(); i++)
+  {
+    if (palette[i] == type)
+      return i;
+  }
+
+  palette.push_back(type);
+  if ((int)palette.size() > (1 << bits))
+    grow(bits == 0 ? 1 : bits * 2);
+  return (int)palette.size() - 1;
+}
+
+void PaletteStorage::grow(int new_bits)
+{
+  std::vector<uint64_t> new_data(((size_t)count * new_bits + 63) / 64, 0);
+  uint64_t new_mask = (1ull << new_bits) - 1;
+
+  // Re-encode existing indices with the wider width. With 0 bits every block
+  // is palette[0], so the zero-filled buffer is already correct.
+  if (bits != 0)
+  {
+    for (int i = 0; i < count; i++)
+    {
+      size_t bit = (size_t)i * bits;
+      uint64_t index = (data[bit >> 6] >> (bit & 63)) & mask();
+      size_t new_bit = (size_t)i * new_bits;
+      new_data[new_bit >> 6] |= (index & new_mask) << (new_bit & 63);
+    }
+  }
+
+  data.swap(new_data);
+  bits = new_bits;
+}
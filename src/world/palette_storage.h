@@ -0,0 +1,60 @@
+#ifndef PALETTE_STORAGE_H
+#define PALETTE_STORAGE_H
+
+#include "blocks.h"
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Palette-compressed block storage. Each storage keeps the distinct block
+// types it contains in a small palette, and stores for every block an index
+// into that palette, bit-packed in 64-bit words. The index width starts at 0
+// bits (a single type, e.g. all air) and widens to 1, 2, 4 then 8 bits as new
+// types get written. Widths are powers of two so an index never straddles two
+// words.
+class PaletteStorage
+{
+public:
+  PaletteStorage(int size);
+  ~PaletteStorage() {}
+
+  BlockType get(int index) const
+  {
+    if (bits == 0)
+      return palette[0];
+    size_t bit = (size_t)index * bits;
+    uint64_t word = data[bit >> 6];
+    return palette[(word >> (bit & 63)) & mask()];
+  }
+
+  void set(int index, BlockType type)
+  {
+    int palette_index = find_or_add(type);
+    if (bits == 0)
+      return;
+    size_t bit = (size_t)index * bits;
+    uint64_t &word = data[bit >> 6];
+    word &= ~(mask() << (bit & 63));
+    word |= (uint64_t)palette_index << (bit & 63);
+  }
+
+  // Decode n consecutive blocks starting at start, one byte per block
+  void unpack(int start, int n, uint8_t *out) const;
+
+  int size() const { return count; }
+  int bits_per_block() const { return bits; }
+  const std::vector<BlockType> &types() const { return palette; }
+  size_t memory_usage() const;
+
+private:
+  int count;
+  int bits = 0;
+  std::vector<BlockType> palette;
+  std::vector<uint64_t> data;
+
+  uint64_t mask() const { return (1ull << bits) - 1; }
+  int find_or_add(BlockType type);
+  void grow(int new_bits);
+};
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef TERRAIN_COLUMN_H
+#define TERRAIN_COLUMN_H
+
+#include "../params.h"
+
+enum BiomeType
+{
+  PLAINS,
+  FOREST,
+  DESERT,
+  MOUNTAINS,
+  TUNDRA,
+  BIOME_COUNT
+};
+
+// What the generator knows about a column of blocks, from the noise alone
+struct TerrainColumn
+{
+  int height;
+  BiomeType biome;
+  // Above 0 in rivers
+  float river_strength;
+};
+
+#endif
@@ -13,154 +13,330 @@ void World::prepare(const Camera &camera)
   shader.use();
 }
 
-ivec3 World::retrieve_chunk_coords(const ivec3 &p)
+ivec3 World::retrieve_chunk_coords(const ivec3 &p) const
 {
-  // Efficient chunk coordinate calculation for negative and positive coordinates
-  // Assumes chunks_size is a power of 2 (like 16, 32, etc.)
+  // Arithmetic shifts round towards -infinity, negative coordinates land in
+  // negative chunks
+  static_assert((CHUNKS_SIZE & (CHUNKS_SIZE - 1)) == 0, "chunks size must be a power of 2");
   const int shift = glm::log2((float)chunks_size);
-  return ivec3(
-      (p.x >> shift) - (p.x < 0 ? 1 : 0),
-      0,
-      (p.z >> shift) - (p.z < 0 ? 1 : 0));
+  return ivec3(p.x >> shift, 0, p.z >> shift);
 }
-Chunk World::retrieve_chunk(const ivec3 &p)
+
+ChunkHandle World::retrieve_chunk(const ivec3 &p) const
 {
-  return chunks[retrieve_chunk_coords(p)];
+  return chunks.find(retrieve_chunk_coords(p));
 }
 
-Block World::operator[](const ivec3 &p)
+std::optional<Block> World::try_get_block(const ivec3 &p) const
 {
-  Chunk chunk = retrieve_chunk(p);
-  return chunk[p & ivec3(chunks_size - 1)];
+  if (p.y < 0 || p.y >= WORLD_HEIGHT)
+    return std::nullopt;
+  ChunkHandle chunk = retrieve_chunk(p);
+  if (!chunk || !chunk->generated)
+    return std::nullopt;
+  return (*chunk)[local_coords(p)];
 }
 
-template <typename T>
-bool World::thread_is_done(const std::future<T> &t)
+Block World::operator[](const ivec3 &p) const
 {
-  return t.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  return try_get_block(p).value_or(Block{AIR});
 }
 
-bool World::inside_frustum(const Frustum &frustum, const ivec3 &chunk_coords)
+int World::get_blocks(const ivec3 *positions, int n, Block *out) const
 {
-  // Convert to world coordinates
-  vec3 min = vec3(chunk_coords * CHUNKS_SIZE);
-  vec3 max = min + vec3(CHUNKS_SIZE, WORLD_HEIGHT, CHUNKS_SIZE);
+  // Neighbouring positions usually share a chunk, the map is only searched
+  // when the chunk changes
+  ivec3 chunk_coords;
+  ChunkHandle chunk;
+  int found = 0;
+  for (int i = 0; i < n; i++)
+  {
+    const ivec3 &p = positions[i];
+    ivec3 coords = retrieve_chunk_coords(p);
+    if (i == 0 || coords != chunk_coords)
+    {
+      chunk_coords = coords;
+      chunk = chunks.find(coords);
+      if (chunk && !chunk->generated)
+        chunk = nullptr;
+    }
+    if (!chunk || p.y < 0 || p.y >= WORLD_HEIGHT)
+    {
+      out[i] = Block{AIR};
+      continue;
+    }
+    out[i] = (*chunk)[local_coords(p)];
+    found++;
+  }
+  return found;
+}
 
-  // Calculate center and half-extents of the AABB
-  vec3 center = (min + max) * 0.5f;
-  vec3 extents = (max - min) * 0.5f;
+void World::load_close_chunks(const Frustum &frustum, const ivec3 &player_chunk_coords)
+{
+  close_chunks.recenter(player_chunk_coords);
+  if (close_chunks.culled_with(frustum))
+    return;
 
-  const float EPSILON = 0.1f;
+  // The chunks leaving the frustum were visible until the previous frame
+  if (frame > 0)
+    mark_visible_chunks(frame - 1);
+  close_chunks.cull(frustum, visible_chunks);
+  for (const auto &[chunk_coords, dist_sq] : visible_chunks)
+    load_chunk(chunk_coords)->last_visible_frame = frame;
+}
 
-  // Test AABB against all frustum planes
-  for (int i = 0; i < 6; i++)
+void World::mark_visible_chunks(uint64_t visible_frame)
+{
+  for (const auto &[chunk_coords, dist_sq] : visible_chunks)
   {
-    const vec4 &plane = frustum.planes[i];
-    vec3 normal = vec3(plane);
-
-    // TODO il y a un pb avec un des coins qui doit etre calculé par un min au lieu d'un max pour le z négatif, surely.
-
-    // Calculate radius in the direction of the plane normal
-    float radius = extents.x * std::abs(normal.x) +
-                   extents.y * std::abs(normal.y) +
-                   extents.z * std::abs(normal.z);
+    if (ChunkHandle chunk = chunks.find(chunk_coords))
+      chunk->last_visible_frame = visible_frame;
+  }
+}
 
-    // Calculate distance from center to plane
-    float distance = dot(normal, center) + plane.w;
+void World::unload_far_chunks(const ivec3 &player_chunk_coords)
+{
+  struct UnloadCandidate
+  {
+    ivec3 coords;
+    uint64_t last_visible_frame;
+    size_t size;
+  };
 
-    // If distance is negative and greater than radius, the AABB is outside
-    if (distance < -radius - EPSILON)
+  // Past render distance, neighbours being generated and cancelled jobs,
+  // with a margin so that chunks are not reloaded as soon as unloaded
+  int max_distance = render_distance + UNLOAD_MARGIN;
+  vector<ivec3> far_chunks;
+  vector<UnloadCandidate> candidates;
+  size_t total_size = 0;
+  mark_visible_chunks(frame);
+  chunks.for_each([&](const ivec3 &coords, const ChunkHandle &chunk)
+                  {
+    // Being written to by a worker, not even measured
+    if (chunk->generating || chunk->meshing)
+      return;
+    ivec3 d = coords - player_chunk_coords;
+    int dist_sq = d.x * d.x + d.z * d.z;
+    if (dist_sq >= max_distance * max_distance)
     {
-      return false;
+      far_chunks.push_back(coords);
+      return;
     }
+    // Out of render distance, only the blocks are kept around
+    if (dist_sq >= render_distance * render_distance && chunk->render_state)
+      chunk->release_render_state();
+    size_t size = chunk->memory_usage();
+    total_size += size;
+    candidates.push_back({coords, chunk->last_visible_frame, size}); });
+
+  // Dropping the last handle frees the blocks and the GL buffers
+  for (const ivec3 &coords : far_chunks)
+    chunks.erase(coords);
+
+  if (total_size <= memory_cap)
+    return;
+  std::sort(candidates.begin(), candidates.end(),
+            [](const UnloadCandidate &a, const UnloadCandidate &b)
+            { return a.last_visible_frame < b.last_visible_frame; });
+  for (const UnloadCandidate &candidate : candidates)
+  {
+    // Chunks visible this frame are needed whatever the cap
+    if (total_size <= memory_cap || candidate.last_visible_frame == frame)
+      break;
+    chunks.erase(candidate.coords);
+    total_size -= candidate.size;
   }
+  job_queue_outdated = true;
+}
 
-  return true;
+ChunkHandle World::load_chunk(const ivec3 &coords)
+{
+  return chunks.find_or_create(coords);
 }
 
-void World::load_close_chunks(const Frustum &frustum, const ivec3 &player_chunk_coords)
+void World::set_view_clear()
 {
-  visible_chunks.clear();
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  glClearColor(0.63f, 0.86f, 1.0f, 1.0f);
+}
 
-  for (int x = -render_distance; x < render_distance; x++)
-    for (int z = -render_distance; z < render_distance; z++)
-    {
-      float dist_sq = x * x + z * z;
-      ivec3 coords = ivec3(x, 0, z) + player_chunk_coords;
-      if (dist_sq >= render_distance * render_distance)
-        continue;
-      if (coords != player_chunk_coords && !inside_frustum(frustum, coords))
-        continue;
-      visible_chunks.emplace_back(coords, dist_sq);
-    }
+bool World::can_start_job() const
+{
+  // Keep every worker busy while leaving chunks unscheduled as long as
+  // possible, so that the closest ones are picked first
+  return (int)active_jobs.size() < jobs.worker_count() * JOBS_PER_WORKER;
+}
+
+void World::generate_chunk(const ChunkHandle &chunk, const ivec3 &coords)
+{
+  chunk->generating = true;
+  CancellationToken token;
+  active_jobs[coords] = {chunk, token};
+  // The handle is moved to the result so that the chunk is never released
+  // from a worker
+  jobs.submit([chunk, coords, token, this]() mutable
+              { bool completed = generator.fill_with_terrain(chunk->sections, chunk->origin, &token);
+                finished_jobs.push({coords, std::move(chunk), completed}); });
+}
 
-  std::sort(visible_chunks.begin(), visible_chunks.end(),
-            [&](const auto &a, const auto &b)
-            { return a.second < b.second; });
+bool World::mesh_chunk(const ChunkHandle &chunk, const ivec3 &coords)
+{
+  static const ivec3 neighbour_offset[4]{
+      ivec3(0, 0, 1),  // BACKWARD
+      ivec3(0, 0, -1), // FORWARD
+      ivec3(-1, 0, 0), // LEFT
+      ivec3(1, 0, 0),  // RIGHT
+  };
+  // The neighbour's side touching each of our sides
+  static const Direction facing[4]{FORWARD, BACKWARD, RIGHT, LEFT};
 
-  for (const auto &[chunk_coords, dist_sq] : visible_chunks)
+  ChunkHandle neighbours[4];
+  bool ready = true;
+  for (int d = 0; d < 4; d++)
   {
-    if (chunks.find(chunk_coords) == chunks.end())
+    neighbours[d] = load_chunk(coords + neighbour_offset[d]);
+    if (!neighbours[d]->generated)
     {
-      chunks.emplace(std::piecewise_construct,
-                     std::forward_as_tuple(chunk_coords),
-                     std::forward_as_tuple(chunk_coords, &shader));
+      ready = false;
+      if (!neighbours[d]->generating && can_start_job())
+        generate_chunk(neighbours[d], coords + neighbour_offset[d]);
     }
   }
+  if (!ready)
+    return false;
+
+  // Generated chunks are never written to, they can be read from here while
+  // other chunks are being generated.
+  auto borders = std::make_shared<ChunkBorders>();
+  for (int d = 0; d < 4; d++)
+    neighbours[d]->copy_border(facing[d], borders->blocks[d]);
+
+  chunk->meshing = true;
+  CancellationToken token;
+  active_jobs[coords] = {chunk, token};
+  jobs.submit([chunk, coords, borders, token, this]() mutable
+              { bool completed = chunk->prepare_mesh_data(*borders, meshing_mode, &token);
+                if (completed)
+                  chunk->stage_mesh(staging_ring);
+                finished_jobs.push({coords, std::move(chunk), completed}); });
+  return true;
 }
 
-void World::set_view_clear()
+void World::update_job_queue(const Frustum &frustum, const ivec3 &player_chunk_coords)
 {
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glClearColor(0.63f, 0.86f, 1.0f, 1.0f);
+  // Candidates and whether they are in the frustum come from close_chunks,
+  // already culled with this frustum unless called on its own
+  load_close_chunks(frustum, player_chunk_coords);
+  const ivec3 *candidates = close_chunks.candidates();
+  int count = close_chunks.size();
+  // Missing chunks need a job too
+  std::vector<uint8_t> needs_job(count, 1);
+  chunks.find_each(candidates, count, [&](int i, const ChunkHandle &chunk)
+                   { needs_job[i] = !(chunk->generating || chunk->meshing ||
+                                      (chunk->generated && !chunk->dirty)); });
+
+  job_queue.clear();
+  for (int i = 0; i < count; i++)
+  {
+    if (needs_job[i])
+      job_queue.push(candidates[i], ChunkJobQueue::priority(close_chunks.distance(i), close_chunks.visible(i),
+                                                            render_distance));
+  }
+
+  // Neighbours of the chunks at render distance are generated too, only
+  // jobs further than that are useless
+  int max_distance = render_distance + 2;
+  for (auto &[coords, job] : active_jobs)
+  {
+    ivec3 d = coords - player_chunk_coords;
+    if (d.x * d.x + d.z * d.z >= max_distance * max_distance)
+      job.token.cancel();
+  }
+  job_queue_outdated = false;
 }
 
 void World::add_chunks_to_render_queue()
 {
-  for (auto &[coords, _] : visible_chunks)
+  ivec3 coords;
+  while (can_start_job() && job_queue.pop(coords))
   {
-    Chunk *chunk = &chunks[coords];
-    if (chunk->dirty && !chunk->meshing &&
-        active_threads.size() < MAX_ACTIVE_THREADS)
+    ChunkHandle chunk = load_chunk(coords);
+    if (!chunk->generated)
     {
-      chunk->meshing = true;
-      active_threads.emplace_back(
-          make_pair(chunk, std::async(std::launch::async, [chunk, this]()
-                                      {
-                        generator.fill_with_terrain(chunk->blocks, chunk->origin, chunk->active_count);
-                        chunk->prepare_mesh_data(generator, this->chunks); })));
+      if (!chunk->generating)
+        generate_chunk(chunk, coords);
     }
+    else if (chunk->dirty && !chunk->meshing)
+      mesh_chunk(chunk, coords);
   }
 }
 
 void World::cleanup_meshed_chunks()
 {
-  for (auto it = active_threads.begin(); it != active_threads.end();)
+  staging_ring.reclaim();
+  ChunkJobResult result;
+  while (finished_jobs.pop(result))
   {
-    auto &[chunk, t] = *it;
-    if (thread_is_done(t))
+    const ChunkHandle &chunk = result.chunk;
+    active_jobs.erase(result.coords);
+    job_queue_outdated = true;
+
+    if (chunk->meshing)
     {
-      chunk->upload_to_gpu();
-      chunk->dirty = false;
-      chunk->meshing = false;
-      it = active_threads.erase(it);
+      // Stays flagged as meshing until uploaded. A cancelled mesh stays
+      // dirty and gets rebuilt when needed again.
+      if (result.completed)
+        pending_uploads.push_back(chunk);
+      else
+        chunk->meshing = false;
     }
     else
-      ++it;
+    {
+      if (result.completed)
+        chunk->generated = true;
+      else
+        chunk->clear_blocks();
+      chunk->generating = false;
+    }
+  }
+
+  // At least one upload per frame, however big, so that uploads progress
+  size_t uploaded = 0;
+  while (!pending_uploads.empty() && (uploaded == 0 || uploaded < upload_budget))
+  {
+    ChunkHandle chunk = std::move(pending_uploads.front());
+    pending_uploads.pop_front();
+    chunk->upload_to_gpu(mesh_buffer, staging_ring);
+    uploaded += chunk->render_state->size;
+    chunk->dirty = false;
+    chunk->meshing = false;
   }
+  staging_ring.end_frame();
 }
 
 void World::render_chunks(const Frustum &frustum, const ivec3 &player_chunk_coords, const Camera &camera)
 {
+  vao.bind();
+  mesh_buffer.bind(0);
+  shader.uniform_bool("multiDraw", multi_draw);
+  draw_batch.clear();
   for (auto &[coords, _] : visible_chunks)
   {
-    Chunk &chunk = chunks[coords];
-    if (!chunk.dirty)
+    // Chunks being remeshed draw their previous mesh, chunks never uploaded
+    // draw nothing
+    ChunkHandle chunk = chunks.find(coords);
+    if (!chunk || !chunk->render_state)
+      continue;
+    if (multi_draw)
+      chunk->add_draws(camera, frustum, draw_batch);
+    else
     {
-      shader.uniform_vec3("chunkOrigin", chunk.origin);
-      chunk.render(camera);
+      shader.uniform_vec3("chunkOrigin", chunk->origin);
+      chunk->render(camera, frustum, shader);
     }
   }
+  if (multi_draw)
+    draw_batch.draw(1);
 }
 
 void World::render(const Camera &camera)
@@ -177,8 +353,19 @@ void World::render(const Camera &camera)
   Frustum frustum(pv);
   load_close_chunks(frustum, player_chunk_coords);
   set_view_clear();
+  if (camera.position != last_camera_position || camera.front != last_camera_front)
+  {
+    last_camera_position = camera.position;
+    last_camera_front = camera.front;
+    job_queue_outdated = true;
+  }
+  if (job_queue_outdated)
+    update_job_queue(frustum, player_chunk_coords);
   add_chunks_to_render_queue();
   cleanup_meshed_chunks();
+  mesh_buffer.defragment(DEFRAG_BUDGET);
   render_chunks(frustum, player_chunk_coords, camera);
-  // TODO every minutes, remove from memory very far chunks (burn to memory any change made to them).
+  if (frame % UNLOAD_INTERVAL == 0)
+    unload_far_chunks(player_chunk_coords);
+  frame++;
 }
\ No newline at end of file
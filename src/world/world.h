@@ -2,41 +2,30 @@
 #define WORLD_H
 
 #include "chunk.h"
+#include "chunk_map.h"
 #include "world_generator.h"
+#include "chunk_job_queue.h"
+#include "chunk_ring.h"
+#include "../jobs/job_system.h"
+#include "../jobs/cancellation_token.h"
+#include "../jobs/mpsc_queue.h"
 #include <algorithm>
+#include <deque>
+#include <optional>
 
-// TODO move
-struct Frustum
+struct ChunkJob
 {
-  glm::vec4 planes[6];
-  Frustum() = default;
-  ~Frustum() {};
-  explicit Frustum(const glm::mat4 &pv)
-  {
-    // Left plane
-    planes[0] = glm::vec4(pv[0][3] + pv[0][0], pv[1][3] + pv[1][0],
-                          pv[2][3] + pv[2][0], pv[3][3] + pv[3][0]);
-    // Right plane
-    planes[1] = glm::vec4(pv[0][3] - pv[0][0], pv[1][3] - pv[1][0],
-                          pv[2][3] - pv[2][0], pv[3][3] - pv[3][0]);
-    // Bottom plane
-    planes[2] = glm::vec4(pv[0][3] + pv[0][1], pv[1][3] + pv[1][1],
-                          pv[2][3] + pv[2][1], pv[3][3] + pv[3][1]);
-    // Top plane
-    planes[3] = glm::vec4(pv[0][3] - pv[0][1], pv[1][3] - pv[1][1],
-                          pv[2][3] - pv[2][1], pv[3][3] - pv[3][1]);
-    // Near plane
-    planes[4] = glm::vec4(pv[0][3] - pv[0][2], pv[1][3] - pv[1][2],
-                          pv[2][3] - pv[2][2], pv[3][3] - pv[3][2]);
-    // Far plane
-    planes[5] = glm::vec4(pv[0][3] + pv[0][2], pv[1][3] + pv[1][2],
-                          pv[2][3] + pv[2][2], pv[3][3] + pv[3][2]);
-    for (int i = 0; i < 6; i++)
-    {
-      float length = glm::length(glm::vec3(planes[i]));
-      planes[i] /= length;
-    }
-  }
+  ChunkHandle chunk;
+  CancellationToken token;
+};
+
+// Pushed by a worker when its job is over
+struct ChunkJobResult
+{
+  glm::ivec3 coords;
+  ChunkHandle chunk;
+  // Whether the job ran to completion
+  bool completed;
 };
 
 class World
@@ -44,26 +33,87 @@ class World
 public:
   const int render_distance = RENDER_DISTANCE;
   const int chunks_size = CHUNKS_SIZE;
-  unordered_map<glm::ivec3, Chunk> chunks;
+  // Meshes of all the chunks. Declared before the chunks, that free their
+  // range of it when destroyed.
+  MeshBuffer mesh_buffer = MeshBuffer(MESH_BUFFER_SIZE);
+  // Meshes written by the workers, copied into mesh_buffer on upload
+  StagingRing staging_ring = StagingRing(STAGING_RING_SIZE);
+  // Faces are pulled from mesh_buffer, drawing only needs an empty VAO
+  VAO vao;
+  ChunkMap chunks;
+  // Chunks within render distance, and the ones of them in the frustum by
+  // distance, kept from a frame to the next while the camera is still
+  ChunkRing close_chunks = ChunkRing(render_distance);
   vector<pair<glm::ivec3, float>> visible_chunks;
-  vector<pair<Chunk *, std::future<void>>> active_threads;
+  unordered_map<glm::ivec3, ChunkJob> active_jobs;
+  MPSCQueue<ChunkJobResult> finished_jobs;
+  // Meshed chunks waiting for their turn to be uploaded
+  std::deque<ChunkHandle> pending_uploads;
+  ChunkJobQueue job_queue;
+  // Set when the job queue priorities are stale: camera moved, jobs done
+  bool job_queue_outdated = true;
+  glm::vec3 last_camera_position = glm::vec3(0.0f);
+  glm::vec3 last_camera_front = glm::vec3(0.0f);
   Shader shader = Shader("resources/shaders/default.vert", "resources/shaders/default.frag");
   TextureArray texture_array = TextureArray("resources/textures");
   WorldGenerator generator;
+  MeshingMode meshing_mode = MESHING_GREEDY;
+  // Submit every chunk draw of a frame with one glMultiDrawArraysIndirect,
+  // instead of one glDrawArrays per draw with uniforms set in between
+  bool multi_draw = true;
+  MultiDrawBatch draw_batch;
+  size_t memory_cap = CHUNKS_MEMORY_CAP;
+  // Bytes of meshes uploaded per frame
+  size_t upload_budget = UPLOAD_BUDGET;
+  uint64_t frame = 0;
+  // Declared last so that workers are joined before the chunks and queues
+  // they use are destroyed
+  JobSystem jobs;
 
   World();
   ~World();
   void prepare(const Camera &camera);
-  glm::ivec3 retrieve_chunk_coords(const glm::ivec3 &p);
-  Chunk retrieve_chunk(const glm::ivec3 &p);
-  Block operator[](const glm::ivec3 &p);
-  template <typename T>
-  bool thread_is_done(const std::future<T> &t);
+  glm::ivec3 retrieve_chunk_coords(const glm::ivec3 &p) const;
+  // Position of a block in its chunk
+  static glm::ivec3 local_coords(const glm::ivec3 &p)
+  {
+    return glm::ivec3(p.x & (CHUNKS_SIZE - 1), p.y, p.z & (CHUNKS_SIZE - 1));
+  }
+  // Block accessors, from the main thread: they only read generated chunks
+  // and never load missing ones.
+  // Null if the chunk holding p is not loaded
+  ChunkHandle retrieve_chunk(const glm::ivec3 &p) const;
+  // No value if the chunk holding p is not generated or p is above or below
+  // the world
+  std::optional<Block> try_get_block(const glm::ivec3 &p) const;
+  // AIR where try_get_block has no value
+  Block operator[](const glm::ivec3 &p) const;
+  // Reads n blocks at once, AIR where try_get_block has no value. Returns the
+  // number of blocks actually read from a chunk.
+  int get_blocks(const glm::ivec3 *positions, int n, Block *out) const;
+  // Unload the chunks out of range, then the least recently visible ones
+  // until under memory_cap. Chunks with a job in flight are kept. Chunks
+  // past render distance but not unloaded yet lose their GL objects.
   void unload_far_chunks(const glm::ivec3 &player_chunk_coords);
-  bool inside_frustum(const Frustum &frustum, const glm::ivec3 &coords);
+  // Updates visible_chunks when the player changes chunk or the frustum
+  // changes
   void load_close_chunks(const Frustum &frustum, const glm::ivec3 &player_chunk_coords);
+  // Set last_visible_frame of the loaded visible chunks, which is only kept
+  // up to date when needed
+  void mark_visible_chunks(uint64_t visible_frame);
+  ChunkHandle load_chunk(const glm::ivec3 &coords);
+  bool can_start_job() const;
+  void generate_chunk(const ChunkHandle &chunk, const glm::ivec3 &coords);
+  // Mesh a generated chunk once its four neighbours are generated too,
+  // returns false if it has to wait for them
+  bool mesh_chunk(const ChunkHandle &chunk, const glm::ivec3 &coords);
+  // Queue every chunk within render distance that needs a job, by priority,
+  // and cancel the jobs of chunks that went out of range
+  void update_job_queue(const Frustum &frustum, const glm::ivec3 &player_chunk_coords);
   void set_view_clear();
   void add_chunks_to_render_queue();
+  // Drain the jobs finished by the workers, and upload meshes within the
+  // per-frame budget
   void cleanup_meshed_chunks();
   void render_chunks(const Frustum &frustum, const glm::ivec3 &player_chunk_coords, const Camera &camera);
   void render(const Camera &camera);
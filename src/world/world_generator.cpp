@@ -4,88 +4,70 @@
 #include <algorithm>
 #include <vector>
 
-WorldGenerator::WorldGenerator()
+static NoiseSettings noise_settings(int seed, float frequency, int octaves = 1,
+                                    float weighted_strength = 0.0f)
 {
-  std::srand(1337);
-
-  heightNoise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
-  heightNoise.SetFractalType(FastNoiseLite::FractalType_FBm);
-  heightNoise.SetFractalWeightedStrength(2.0f);
-
-  biomeNoise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
-  biomeNoise.SetFrequency(0.01f);
-
-  riverNoise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
-  riverNoise.SetFractalType(FastNoiseLite::FractalType_FBm);
-  riverNoise.SetFractalOctaves(4);
-  riverNoise.SetFrequency(0.008f);
-
-  detailNoise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
-  detailNoise.SetFrequency(0.05f);
-
-  treeNoise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
-  treeNoise.SetFrequency(0.1f);
+  NoiseSettings settings;
+  settings.seed = seed;
+  settings.frequency = frequency;
+  settings.octaves = octaves;
+  settings.weighted_strength = weighted_strength;
+  return settings;
+}
 
+WorldGenerator::WorldGenerator(int seed)
+    : heightNoise(noise_settings(seed, 0.01f, 3, 2.0f)),
+      biomeNoise(noise_settings(seed, 0.01f)),
+      riverNoise(noise_settings(seed, 0.008f, 4)),
+      detailNoise(noise_settings(seed, 0.05f)),
+      treeNoise(noise_settings(seed, 0.1f)),
+      seed(seed)
+{
   waterLevel = static_cast<int>(WORLD_HEIGHT * 0.4f);
 }
 
-std::vector<BiomeInfluence> WorldGenerator::get_biome_influences(
-    int x, int z, const glm::ivec3 &origin) const
+void WorldGenerator::biome_sample_offset(int i, float &dx, float &dz)
 {
-  std::vector<BiomeInfluence> influences;
   const float BIOME_BLEND_RADIUS = 8.0f; // Blend radius in blocks
+  float angle = (i - 1) * (2.0f * 3.14159f / 8.0f);
+  dx = cosf(angle) * BIOME_BLEND_RADIUS;
+  dz = sinf(angle) * BIOME_BLEND_RADIUS;
+}
 
-  // Get central biome
-  float centralValue =
-      biomeNoise.GetNoise((float)(x + origin.x), (float)(z + origin.z));
-  BiomeType centralBiome = biome_from_noise(centralValue);
-  influences.push_back({centralBiome, 1.0f});
-
-  // Sample biomes in a circle
-  for (int i = 0; i < 8; i++)
+BiomeWeights WorldGenerator::blend_biomes(const float *biome_values) const
+{
+  // The central biome weighs 1, each different biome around 0.5
+  BiomeWeights blend;
+  BiomeType centralBiome = biome_from_noise(biome_values[0]);
+  blend.weights[centralBiome] = 1.0f;
+  float totalWeight = 1.0f;
+  for (int i = 1; i < BIOME_SAMPLES; i++)
   {
-    float angle = i * (2.0f * 3.14159f / 8.0f);
-    float sampleX = x + cosf(angle) * BIOME_BLEND_RADIUS;
-    float sampleZ = z + sinf(angle) * BIOME_BLEND_RADIUS;
-
-    float biomeValue = biomeNoise.GetNoise((float)(sampleX + origin.x),
-                                           (float)(sampleZ + origin.z));
-    BiomeType biomeSample = biome_from_noise(biomeValue);
-
+    BiomeType biomeSample = biome_from_noise(biome_values[i]);
     if (biomeSample != centralBiome)
     {
-      float weight = 0.5f;
-
-      bool found = false;
-      for (auto &influence : influences)
-      {
-        if (influence.type == biomeSample)
-        {
-          influence.weight += weight;
-          found = true;
-          break;
-        }
-      }
-
-      if (!found)
-      {
-        influences.push_back({biomeSample, weight});
-      }
+      blend.weights[biomeSample] += 0.5f;
+      totalWeight += 0.5f;
     }
   }
-  // Normalize weights
-  float totalWeight = 0.0f;
-  for (const auto &influence : influences)
-  {
-    totalWeight += influence.weight;
-  }
 
-  for (auto &influence : influences)
+  for (float &weight : blend.weights)
+    weight /= totalWeight;
+  return blend;
+}
+
+BiomeWeights WorldGenerator::interpolate_biomes(const BiomeWeights &w00, const BiomeWeights &w10,
+                                                const BiomeWeights &w01, const BiomeWeights &w11,
+                                                float fx, float fz)
+{
+  BiomeWeights result;
+  for (int b = 0; b < BIOME_COUNT; b++)
   {
-    influence.weight /= totalWeight;
+    float w0 = w00.weights[b] + (w10.weights[b] - w00.weights[b]) * fx;
+    float w1 = w01.weights[b] + (w11.weights[b] - w01.weights[b]) * fx;
+    result.weights[b] = w0 + (w1 - w0) * fz;
   }
-
-  return influences;
+  return result;
 }
 
 BiomeType WorldGenerator::biome_from_noise(float noiseValue) const
@@ -102,31 +84,6 @@ BiomeType WorldGenerator::biome_from_noise(float noiseValue) const
   return TUNDRA;      // 15% chance
 }
 
-BiomeType WorldGenerator::get_dominant_biome(int x, int z, const glm::ivec3 &origin) const
-{
-  float biomeValue =
-      biomeNoise.GetNoise((float)(x + origin.x), (float)(z + origin.z));
-  return biome_from_noise(biomeValue);
-}
-
-float WorldGenerator::get_river_strength(int x, int z, const glm::ivec3 &origin) const
-{
-  BiomeType biome = get_dominant_biome(x, z, origin);
-  if (biome == MOUNTAINS)
-  {
-    return 0.0f;
-  }
-  float riverValue =
-      riverNoise.GetNoise((float)(x + origin.x), (float)(z + origin.z));
-  float riverStrength = 1.0f - (std::abs(riverValue) / 0.05f);
-  return std::max(0.0f, riverStrength);
-}
-
-bool WorldGenerator::is_river(int x, int z, const glm::ivec3 &origin) const
-{
-  return get_river_strength(x, z, origin) > 0.0f;
-}
-
 float WorldGenerator::get_biome_height_modifier(const BiomeType &biome, float baseHeight) const
 {
   switch (biome)
@@ -146,39 +103,104 @@ float WorldGenerator::get_biome_height_modifier(const BiomeType &biome, float ba
   }
 }
 
-int WorldGenerator::get_height(int x, int z, const glm::ivec3 &origin) const
+void WorldGenerator::get_columns(int x, int z, int width, int depth, TerrainColumn *out) const
 {
-  float baseHeight = heightNoise.GetNoise((float)(x + origin.x), (float)(z + origin.z)) / 2.0f + 0.5f;
-  float detailHeight = detailNoise.GetNoise((float)(x + origin.x), (float)(z + origin.z)) / 2.0f + 0.5f;
-  baseHeight += detailHeight * 0.01f;
+  const int n = width * depth;
+  std::vector<float> xs(n), zs(n);
+  std::vector<float> biome_values(n), river_values(n), height_values(n), detail_values(n);
+
+  for (int j = 0; j < depth; j++)
+    for (int i = 0; i < width; i++)
+    {
+      xs[j * width + i] = (float)(x + i);
+      zs[j * width + i] = (float)(z + j);
+    }
+  biomeNoise.get_batch(xs.data(), zs.data(), n, biome_values.data());
+  riverNoise.get_batch(xs.data(), zs.data(), n, river_values.data());
+  heightNoise.get_batch(xs.data(), zs.data(), n, height_values.data());
+  detailNoise.get_batch(xs.data(), zs.data(), n, detail_values.data());
+
+  // Biome weights on the lattice points covering the area
+  int lattice_x = lattice_cell(x);
+  int lattice_z = lattice_cell(z);
+  int lattice_width = (lattice_cell(x + width - 1) - lattice_x) / BIOME_CELL + 2;
+  int lattice_depth = (lattice_cell(z + depth - 1) - lattice_z) / BIOME_CELL + 2;
+  int lattice_points = lattice_width * lattice_depth;
+  std::vector<float> lattice_xs(lattice_points * BIOME_SAMPLES);
+  std::vector<float> lattice_zs(lattice_points * BIOME_SAMPLES);
+  std::vector<float> lattice_values(lattice_points * BIOME_SAMPLES);
+  for (int p = 0; p < lattice_points; p++)
+  {
+    int px = lattice_x + (p % lattice_width) * BIOME_CELL;
+    int pz = lattice_z + (p / lattice_width) * BIOME_CELL;
+    lattice_xs[p * BIOME_SAMPLES] = (float)px;
+    lattice_zs[p * BIOME_SAMPLES] = (float)pz;
+    for (int i = 1; i < BIOME_SAMPLES; i++)
+    {
+      float dx, dz;
+      biome_sample_offset(i, dx, dz);
+      lattice_xs[p * BIOME_SAMPLES + i] = px + dx;
+      lattice_zs[p * BIOME_SAMPLES + i] = pz + dz;
+    }
+  }
+  biomeNoise.get_batch(lattice_xs.data(), lattice_zs.data(), lattice_points * BIOME_SAMPLES,
+                       lattice_values.data());
+  std::vector<BiomeWeights> lattice(lattice_points);
+  for (int p = 0; p < lattice_points; p++)
+    lattice[p] = blend_biomes(lattice_values.data() + p * BIOME_SAMPLES);
+
+  for (int j = 0; j < depth; j++)
+    for (int i = 0; i < width; i++)
+    {
+      int cx = lattice_cell(x + i);
+      int cz = lattice_cell(z + j);
+      int l = (cz - lattice_z) / BIOME_CELL * lattice_width + (cx - lattice_x) / BIOME_CELL;
+      BiomeWeights weights = interpolate_biomes(
+          lattice[l], lattice[l + 1], lattice[l + lattice_width],
+          lattice[l + lattice_width + 1], (float)(x + i - cx) / BIOME_CELL,
+          (float)(z + j - cz) / BIOME_CELL);
+      int c = j * width + i;
+      out[c] = make_column(weights, biome_values[c], river_values[c],
+                           height_values[c], detail_values[c]);
+    }
+}
 
-  std::vector<BiomeInfluence> biomeInfluences =
-      get_biome_influences(x, z, origin);
+TerrainColumn WorldGenerator::make_column(const BiomeWeights &weights, float biome_value, float river_value,
+                                          float height_value, float detail_value) const
+{
+  TerrainColumn column;
+  column.biome = biome_from_noise(biome_value);
+  column.river_strength = 0.0f;
+  if (column.biome != MOUNTAINS)
+    column.river_strength = std::max(0.0f, 1.0f - (std::abs(river_value) / 0.05f));
+
+  float baseHeight = height_value / 2.0f + 0.5f;
+  float detailHeight = detail_value / 2.0f + 0.5f;
+  baseHeight += detailHeight * 0.01f;
 
   float blendedHeight = 0.0f;
-  for (const auto &influence : biomeInfluences)
+  for (int b = 0; b < BIOME_COUNT; b++)
   {
-    float biomeHeight = get_biome_height_modifier(influence.type, baseHeight);
-    blendedHeight += biomeHeight * influence.weight;
+    if (weights.weights[b] > 0.0f)
+      blendedHeight += get_biome_height_modifier((BiomeType)b, baseHeight) * weights.weights[b];
   }
 
   int naturalTerrainHeight =
       std::min(WORLD_HEIGHT - 1, (int)((float)WORLD_HEIGHT * blendedHeight + 1));
+  column.height = naturalTerrainHeight;
 
-  float riverStrength = get_river_strength(x, z, origin);
-  if (riverStrength > 0.0f)
+  if (column.river_strength > 0.0f)
   {
     float riverDepth =
         0.1f + blendedHeight * 0.1f; // Make deeper rivers in higher terrain
-    float riverDepthAtPoint = riverDepth * riverStrength;
+    float riverDepthAtPoint = riverDepth * column.river_strength;
     float minRiverBottom = (float)waterLevel / WORLD_HEIGHT - 0.05f;
     blendedHeight = std::max(minRiverBottom, blendedHeight - riverDepthAtPoint);
     int terrainHeight =
         std::min(WORLD_HEIGHT - 1, (int)((float)WORLD_HEIGHT * blendedHeight + 1));
-    return std::min(terrainHeight, naturalTerrainHeight);
+    column.height = std::min(terrainHeight, naturalTerrainHeight);
   }
-
-  return naturalTerrainHeight;
+  return column;
 }
 
 BlockType WorldGenerator::get_surface_block(const BiomeType &biome, bool is_river, int y) const
@@ -224,16 +246,28 @@ BlockType WorldGenerator::get_subsurface_block(const BiomeType &biome, int depth
   return STONE;
 }
 
-void WorldGenerator::fill_with_terrain(Block *blocks, const glm::ivec3 &origin, int &active_count) const
+bool WorldGenerator::fill_with_terrain(ChunkSection *sections, const glm::ivec3 &origin,
+                                       const CancellationToken *token) const
 {
+  if (token && token->cancelled())
+    return false;
+
+  // Columns around the chunk too, for the trees whose leaves reach into it
+  const int area_size = CHUNKS_SIZE + 2 * TREE_RADIUS;
+  std::vector<TerrainColumn> area(area_size * area_size);
+  get_columns(origin.x - TREE_RADIUS, origin.z - TREE_RADIUS, area_size, area_size, area.data());
+
   for (int x = 0; x < CHUNKS_SIZE; x++)
   {
+    if (token && token->cancelled())
+      return false;
+
     for (int z = 0; z < CHUNKS_SIZE; z++)
     {
-      BiomeType biome = get_dominant_biome(x, z, origin);
-      float riverStrength = get_river_strength(x, z, origin);
-      bool is_river_block = riverStrength > 0.0f;
-      int scaled_height = get_height(x, z, origin);
+      const TerrainColumn &column = area[(z + TREE_RADIUS) * area_size + x + TREE_RADIUS];
+      BiomeType biome = column.biome;
+      bool is_river_block = column.river_strength > 0.0f;
+      int scaled_height = column.height;
 
       // Fill terrain blocks
       for (int y = 0; y + origin.y < scaled_height && y < WORLD_HEIGHT; y++)
@@ -251,8 +285,7 @@ void WorldGenerator::fill_with_terrain(Block *blocks, const glm::ivec3 &origin,
           blockType = get_subsurface_block(biome, depth, y + origin.y);
         }
 
-        blocks[ivec3_to_index(glm::ivec3(x, y, z))].type = blockType;
-        active_count++;
+        set_block(sections, glm::ivec3(x, y, z), blockType);
       }
 
       // Set surface blocks
@@ -261,9 +294,8 @@ void WorldGenerator::fill_with_terrain(Block *blocks, const glm::ivec3 &origin,
       {
         BlockType surfaceType =
             get_surface_block(biome, is_river_block, scaled_height);
-        blocks[ivec3_to_index(glm::ivec3(x, scaled_height - origin.y, z))]
-            .type = surfaceType;
-        active_count++;
+        set_block(sections, glm::ivec3(x, scaled_height - origin.y, z),
+                  surfaceType);
       }
 
       // Add water for rivers only if it's below the water level and at or
@@ -276,21 +308,25 @@ void WorldGenerator::fill_with_terrain(Block *blocks, const glm::ivec3 &origin,
         {
           if (y >= 0 && y < WORLD_HEIGHT)
           {
-            blocks[ivec3_to_index(glm::ivec3(x, y, z))].type = WATER;
-            active_count++;
+            set_block(sections, glm::ivec3(x, y, z), WATER);
           }
         }
       }
-
-      // Add trees
-      if (should_place_tree(x, z, scaled_height, biome, is_river_block,
-                            origin))
-      {
-        int y_pos = scaled_height - origin.y + 1;
-        place_tree(blocks, x, y_pos, z, active_count);
-      }
     }
   }
+
+  // Trees go after the terrain so that leaves only fill air, wherever the
+  // tree stands. Every chunk a tree overlaps places its own part of it, the
+  // same way.
+  for (int z = -TREE_RADIUS; z < CHUNKS_SIZE + TREE_RADIUS; z++)
+    for (int x = -TREE_RADIUS; x < CHUNKS_SIZE + TREE_RADIUS; x++)
+    {
+      const TerrainColumn &column = area[(z + TREE_RADIUS) * area_size + x + TREE_RADIUS];
+      if (should_place_tree(x, z, column.height, column.biome,
+                            column.river_strength > 0.0f, origin))
+        place_tree(sections, x, column.height - origin.y + 1, z, origin);
+    }
+  return true;
 }
 
 bool WorldGenerator::should_place_tree(int x, int z, int height, const BiomeType &biome,
@@ -313,28 +349,29 @@ bool WorldGenerator::should_place_tree(int x, int z, int height, const BiomeType
   default:
     return false;
   }
-  return random() < tree_density;
+  return random(x + origin.x, height, z + origin.z) < tree_density;
 }
 
-void WorldGenerator::place_tree(Block *blocks, int x, int y, int z, int &active_count) const
+void WorldGenerator::place_tree(ChunkSection *sections, int x, int y, int z,
+                                const glm::ivec3 &origin) const
 {
   int tree_height =
       4 +
-      (int)(treeNoise.GetNoise((float)x * 10.0f, (float)z * 10.0f) * 2.0f);
+      (int)(treeNoise.get((float)(x + origin.x) * 10.0f, (float)(z + origin.z) * 10.0f) * 2.0f);
 
   // Place trunk
-  for (int i = 0; i < tree_height; i++)
+  bool trunk_inside = x >= 0 && x < CHUNKS_SIZE && z >= 0 && z < CHUNKS_SIZE;
+  for (int i = 0; i < tree_height && trunk_inside; i++)
   {
     if (y + i >= WORLD_HEIGHT)
       break;
-    blocks[ivec3_to_index(glm::ivec3(x, y + i, z))].type = LOGS;
-    active_count++;
+    set_block(sections, glm::ivec3(x, y + i, z), LOGS);
   }
 
   // Place leaves
-  for (int dx = -2; dx <= 2; dx++)
+  for (int dx = -TREE_RADIUS; dx <= TREE_RADIUS; dx++)
   {
-    for (int dz = -2; dz <= 2; dz++)
+    for (int dz = -TREE_RADIUS; dz <= TREE_RADIUS; dz++)
     {
       for (int dy = -1; dy <= 3; dy++)
       {
@@ -351,10 +388,9 @@ void WorldGenerator::place_tree(Block *blocks, int x, int y, int z, int &active_
           if (lx >= 0 && lx < CHUNKS_SIZE && ly >= 0 && ly < WORLD_HEIGHT &&
               lz >= 0 && lz < CHUNKS_SIZE)
           {
-            if (blocks[ivec3_to_index(glm::ivec3(lx, ly, lz))].type == AIR)
+            if (get_block(sections, glm::ivec3(lx, ly, lz)) == AIR)
             {
-              blocks[ivec3_to_index(glm::ivec3(lx, ly, lz))].type = LEAVES;
-              active_count++;
+              set_block(sections, glm::ivec3(lx, ly, lz), LEAVES);
             }
           }
         }
@@ -1,62 +1,114 @@
 #ifndef WORLD_GENERATOR_H
 #define WORLD_GENERATOR_H
 
-#include "fastnoiselite.h"
+#include "batch_noise.h"
 #include "../params.h"
 #include "blocks.h"
+#include "chunk_section.h"
+#include "terrain_column.h"
+#include "../jobs/cancellation_token.h"
 #include <glm/glm.hpp>
+#include <cstdint>
 #include <vector>
 
-enum BiomeType
+// Influence of each biome on a column, summing to 1
+struct BiomeWeights
 {
-  PLAINS,
-  FOREST,
-  DESERT,
-  MOUNTAINS,
-  TUNDRA,
-  BIOME_COUNT
-};
-
-struct BiomeInfluence
-{
-  BiomeType type;
-  float weight;
+  float weights[BIOME_COUNT] = {0};
 };
 
 class WorldGenerator
 {
 public:
-  FastNoiseLite heightNoise;
-  FastNoiseLite biomeNoise;
-  FastNoiseLite riverNoise;
-  FastNoiseLite detailNoise;
-  FastNoiseLite treeNoise;
+  BatchNoise heightNoise;
+  BatchNoise biomeNoise;
+  BatchNoise riverNoise;
+  BatchNoise detailNoise;
+  BatchNoise treeNoise;
   int waterLevel;
+  // Drives the noises and the decorations: a seed always gives the same
+  // world, whatever the order chunks are generated in
+  int seed;
 
-  WorldGenerator();
+  WorldGenerator(int seed = 1337);
   ~WorldGenerator() {}
-  std::vector<BiomeInfluence> get_biome_influences(int x, int z, const glm::ivec3 &origin) const;
+  // Weights from the biome noise at a lattice point, then at the
+  // BIOME_SAMPLES - 1 points around it
+  BiomeWeights blend_biomes(const float *biome_values) const;
   BiomeType biome_from_noise(float noiseValue) const;
-  BiomeType get_dominant_biome(int x, int z, const glm::ivec3 &origin) const;
-  float get_river_strength(int x, int z, const glm::ivec3 &origin) const;
-  bool is_river(int x, int z, const glm::ivec3 &origin) const;
   float get_biome_height_modifier(const BiomeType &biome, float baseHeight) const;
-  int get_height(int x, int z, const glm::ivec3 &origin) const;
+  // Biome, river strength and height of the width x depth columns from
+  // (x, z) in world coordinates, out[j * width + i] for column (x + i, z + j).
+  // Noises are sampled in batches, biome weights are blended on a lattice of
+  // BIOME_CELL blocks and interpolated between its points.
+  void get_columns(int x, int z, int width, int depth, TerrainColumn *out) const;
   BlockType get_surface_block(const BiomeType &biome, bool is_river, int y) const;
   BlockType get_subsurface_block(const BiomeType &biome, int depth, int y) const;
-  void fill_with_terrain(Block *blocks, const glm::ivec3 &origin, int &active_count) const;
+  // Computes the columns of the chunk, then fills its sections from them.
+  // Returns false if cancelled before the end, leaving the chunk partially
+  // filled
+  bool fill_with_terrain(ChunkSection *sections, const glm::ivec3 &origin,
+                         const CancellationToken *token = nullptr) const;
   bool should_place_tree(int x, int z, int height, const BiomeType &biome, bool is_river, const glm::ivec3 &origin) const;
-  void place_tree(Block *blocks, int x, int y, int z, int &active_count) const;
+  // Places the part of a tree standing at (x, y, z) that is inside the
+  // chunk, x and z can be up to TREE_RADIUS outside of it
+  void place_tree(ChunkSection *sections, int x, int y, int z, const glm::ivec3 &origin) const;
 
 private:
-  static float random()
+  static const int BIOME_SAMPLES = 9;
+  static const int BIOME_CELL = 4;
+  // How far leaves reach from the trunk
+  static const int TREE_RADIUS = 2;
+
+  // Lattice point at or before v, rounded towards -infinity
+  static int lattice_cell(int v)
+  {
+    return (v >= 0 ? v : v - BIOME_CELL + 1) / BIOME_CELL * BIOME_CELL;
+  }
+
+  // Column from its biome weights and the noises sampled at it
+  TerrainColumn make_column(const BiomeWeights &weights, float biome_value, float river_value,
+                            float height_value, float detail_value) const;
+  // Bilinear interpolation of the weights at the corners of a lattice cell,
+  // fx and fz in [0, 1)
+  static BiomeWeights interpolate_biomes(const BiomeWeights &w00, const BiomeWeights &w10,
+                                         const BiomeWeights &w01, const BiomeWeights &w11,
+                                         float fx, float fz);
+  // Offset of the i-th biome blending sample around a column, i >= 1
+  static void biome_sample_offset(int i, float &dx, float &dz);
+
+  // Random value in [0, 1) for a world position, computed from the seed and
+  // the position alone. salt tells apart decisions made at the same position.
+  float random(int x, int y, int z, uint32_t salt = 0) const
+  {
+    return (hash_position(x, y, z, salt) >> 8) * (1.0f / (1 << 24));
+  }
+
+  uint32_t hash_position(int x, int y, int z, uint32_t salt) const
+  {
+    uint64_t h = (uint64_t)(uint32_t)seed ^ (uint64_t)salt << 32;
+    h ^= (uint64_t)(uint32_t)x * 0x9E3779B97F4A7C15ull;
+    h ^= (uint64_t)(uint32_t)y * 0xC2B2AE3D27D4EB4Full;
+    h ^= (uint64_t)(uint32_t)z * 0x165667B19E3779F9ull;
+    // splitmix64 finalizer
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBull;
+    h ^= h >> 31;
+    return (uint32_t)(h >> 32);
+  }
+
+  static BlockType get_block(const ChunkSection *sections, const glm::ivec3 &p)
   {
-    return static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
+    return sections[p.y / SECTION_HEIGHT].get(
+        glm::ivec3(p.x, p.y % SECTION_HEIGHT, p.z));
   }
 
-  static int ivec3_to_index(const glm::ivec3 &p)
+  static void set_block(ChunkSection *sections, const glm::ivec3 &p, BlockType type)
   {
-    return p.z * CHUNKS_SIZE * WORLD_HEIGHT + p.y * CHUNKS_SIZE + p.x;
+    sections[p.y / SECTION_HEIGHT].set(
+        glm::ivec3(p.x, p.y % SECTION_HEIGHT, p.z), type);
   }
 };
 